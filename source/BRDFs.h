@@ -1,6 +1,7 @@
 #pragma once
 #include <cassert>
 #include "Math.h"
+#include "SIMD.h"
 
 namespace dae
 {
@@ -108,5 +109,63 @@ namespace dae
 			return GeometryFunction_SchlickGGX(n, v, roughness) * GeometryFunction_SchlickGGX(n, l, roughness);
 		}
 
+#pragma region Batched
+		// The same functions for a lane per sample, Lanes is float or one of the SIMD::FloatLanes registers.
+		// Directions are expected normalized like above, results match the scalar versions up to float rounding
+		// except for Phong, which swaps powf for SIMD::FastPow (relative error below 7.1e-5 up to an exponent of 70)
+
+		/**
+		 * \return Phong specular intensity per lane, the color is white like the scalar version
+		 */
+		template<typename Lanes>
+		Lanes Phong(float ks, float exp, const SIMD::Vector3Lanes<Lanes>& l, const SIMD::Vector3Lanes<Lanes>& v, const SIMD::Vector3Lanes<Lanes>& n)
+		{
+			using namespace SIMD;
+			const Lanes cosAngle{ Dot(Reflect(l, n), v) };
+			return Mul(Set1<Lanes>(ks), FastPow(Max(Set1<Lanes>(0.f), cosAngle), Set1<Lanes>(exp)));
+		}
+
+		template<typename Lanes>
+		SIMD::ColorRGBLanes<Lanes> FresnelFunction_Schlick(const SIMD::Vector3Lanes<Lanes>& h, const SIMD::Vector3Lanes<Lanes>& v, const ColorRGB& f0)
+		{
+			using namespace SIMD;
+			Lanes a{ Sub(Set1<Lanes>(1.f), Dot(h, v)) };
+			const Lanes aSqr{ Mul(a, a) };
+			a = Mul(Mul(aSqr, aSqr), a);
+
+			return {
+				Add(Set1<Lanes>(f0.r), Mul(Set1<Lanes>(1.f - f0.r), a)),
+				Add(Set1<Lanes>(f0.g), Mul(Set1<Lanes>(1.f - f0.g), a)),
+				Add(Set1<Lanes>(f0.b), Mul(Set1<Lanes>(1.f - f0.b), a)) };
+		}
+
+		template<typename Lanes>
+		Lanes NormalDistribution_GGX(const SIMD::Vector3Lanes<Lanes>& n, const SIMD::Vector3Lanes<Lanes>& h, float roughness)
+		{
+			using namespace SIMD;
+			const float alphaSqr{ roughness * roughness * roughness * roughness };
+			const Lanes cosAngle{ Dot(n, h) };
+			const Lanes b{ Add(Mul(Mul(cosAngle, cosAngle), Set1<Lanes>(alphaSqr - 1)), Set1<Lanes>(1.f)) };
+
+			return Div(Set1<Lanes>(alphaSqr), Mul(Set1<Lanes>(PI), Mul(b, b)));
+		}
+
+		template<typename Lanes>
+		Lanes GeometryFunction_SchlickGGX(const SIMD::Vector3Lanes<Lanes>& n, const SIMD::Vector3Lanes<Lanes>& v, float roughness)
+		{
+			using namespace SIMD;
+			const float a{ roughness * roughness + 1 };
+			const float k{ a * a * 0.125f };
+			const Lanes cosAngle{ Dot(n, v) };
+
+			return Div(cosAngle, Add(Mul(cosAngle, Set1<Lanes>(1 - k)), Set1<Lanes>(k)));
+		}
+
+		template<typename Lanes>
+		Lanes GeometryFunction_Smith(const SIMD::Vector3Lanes<Lanes>& n, const SIMD::Vector3Lanes<Lanes>& v, const SIMD::Vector3Lanes<Lanes>& l, float roughness)
+		{
+			return SIMD::Mul(GeometryFunction_SchlickGGX(n, v, roughness), GeometryFunction_SchlickGGX(n, l, roughness));
+		}
+#pragma endregion
 	}
 }
\ No newline at end of file
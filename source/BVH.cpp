@@ -0,0 +1,434 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <iostream>
+#include <numeric>
+
+namespace dae
+{
+	void BVH::Build(const std::vector<AABB>& primitiveBounds)
+	{
+		const auto startTime{ std::chrono::high_resolution_clock::now() };
+
+		Clear();
+
+		const uint32_t nrPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+		if (nrPrimitives == 0)
+			return;
+
+		m_PrimitiveIndices.resize(nrPrimitives);
+		std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0);
+
+		m_Centroids.resize(nrPrimitives);
+		for (uint32_t index{}; index < nrPrimitives; ++index)
+			m_Centroids[index] = primitiveBounds[index].Center();
+
+		// A binary tree never needs more than 2N - 1 nodes
+		m_Nodes.reserve(2 * size_t(nrPrimitives) - 1);
+
+		BVHNode& root{ m_Nodes.emplace_back() };
+		root.leftFirst = 0;
+		root.primitiveCount = nrPrimitives;
+
+		UpdateNodeBounds(0, primitiveBounds);
+		Subdivide(0, 1, primitiveBounds);
+
+		m_Stats.nodeCount = static_cast<uint32_t>(m_Nodes.size());
+		m_Stats.primitiveCount = nrPrimitives;
+		m_Stats.sahCost = CalculateSAHCost();
+		m_CurrentSAHCost = m_Stats.sahCost;
+
+		PrepareRefit();
+
+		const auto endTime{ std::chrono::high_resolution_clock::now() };
+		m_Stats.buildTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+
+	void BVH::Clear()
+	{
+		// clear keeps the capacity around, rebuilding every frame won't reallocate
+		m_Nodes.clear();
+		m_PrimitiveIndices.clear();
+		m_Centroids.clear();
+		m_RefitSubtreeRoots.clear();
+		m_RefitTopNodes.clear();
+		m_Stats = {};
+		m_CurrentSAHCost = 0.f;
+	}
+
+	bool BVH::Refit(const std::vector<AABB>& primitiveBounds)
+	{
+		if (m_Nodes.empty() || primitiveBounds.size() != m_PrimitiveIndices.size())
+			return false;
+
+		if (m_RefitSubtreeRoots.empty())
+		{
+			// Children are always stored after their parent, a reverse sweep is bottom-up
+			for (uint32_t nodeIndex{ static_cast<uint32_t>(m_Nodes.size()) }; nodeIndex-- > 0;)
+				RefitNode(nodeIndex, primitiveBounds);
+		}
+		else
+		{
+			std::for_each(std::execution::par, m_RefitSubtreeRoots.begin(), m_RefitSubtreeRoots.end(),
+				[&](uint32_t rootIndex)
+				{
+					RefitSubtree(rootIndex, primitiveBounds);
+				});
+
+			for (const uint32_t nodeIndex : m_RefitTopNodes)
+				RefitNode(nodeIndex, primitiveBounds);
+		}
+
+		m_CurrentSAHCost = CalculateSAHCost();
+		return GetQualityRatio() <= m_RebuildThreshold;
+	}
+
+	bool BVH::Update(const std::vector<AABB>& primitiveBounds)
+	{
+		if (Refit(primitiveBounds))
+			return true;
+
+		Build(primitiveBounds);
+		return false;
+	}
+
+	float BVH::CalculateSAHCost() const
+	{
+		if (m_Nodes.empty())
+			return 0.f;
+
+		const float rootArea{ m_Nodes[0].bounds.HalfArea() };
+		if (rootArea <= 0.f)
+			return IntersectionCost * m_Nodes[0].primitiveCount;
+
+		float cost{};
+		for (const BVHNode& node : m_Nodes)
+		{
+			const float areaRatio{ node.bounds.HalfArea() / rootArea };
+
+			if (node.IsLeaf())
+				cost += areaRatio * IntersectionCost * node.primitiveCount;
+			else
+				cost += areaRatio * TraversalCost;
+		}
+
+		return cost;
+	}
+
+	void BVH::PrintStats(const std::string& name) const
+	{
+		std::cout << "**BVH " << name << "**\n";
+		std::cout << ">> PRIMITIVES = " << m_Stats.primitiveCount << std::endl;
+		std::cout << ">> NODES = " << m_Stats.nodeCount << " (" << m_Stats.leafCount << " leaves)" << std::endl;
+		std::cout << ">> DEPTH = " << m_Stats.maxDepth << std::endl;
+		std::cout << ">> SAH COST = " << m_Stats.sahCost << std::endl;
+		std::cout << ">> BUILD TIME = " << m_Stats.buildTimeMs << " ms" << std::endl;
+	}
+
+	void BVH::UpdateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds)
+	{
+		BVHNode& node{ m_Nodes[nodeIndex] };
+		node.bounds = {};
+
+		for (uint32_t index{}; index < node.primitiveCount; ++index)
+			node.bounds.Grow(primitiveBounds[m_PrimitiveIndices[node.leftFirst + index]]);
+	}
+
+	void BVH::PrepareRefit()
+	{
+		if (m_PrimitiveIndices.size() < ParallelRefitThreshold)
+			return;
+
+		// Split the top of the tree level by level until there are enough independent subtrees
+		m_RefitSubtreeRoots.push_back(0);
+		std::vector<uint32_t> nextLevel{};
+
+		while (m_RefitSubtreeRoots.size() < RefitTaskCount)
+		{
+			nextLevel.clear();
+			for (const uint32_t nodeIndex : m_RefitSubtreeRoots)
+			{
+				const BVHNode& node{ m_Nodes[nodeIndex] };
+				if (node.IsLeaf())
+				{
+					nextLevel.push_back(nodeIndex);
+					continue;
+				}
+
+				m_RefitTopNodes.push_back(nodeIndex);
+				nextLevel.push_back(node.leftFirst);
+				nextLevel.push_back(node.leftFirst + 1);
+			}
+
+			// only leaves left
+			if (nextLevel.size() == m_RefitSubtreeRoots.size())
+				break;
+
+			m_RefitSubtreeRoots.swap(nextLevel);
+		}
+
+		// Breadth first order has parents before children, refit them the other way around
+		std::reverse(m_RefitTopNodes.begin(), m_RefitTopNodes.end());
+	}
+
+	void BVH::RefitNode(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds)
+	{
+		BVHNode& node{ m_Nodes[nodeIndex] };
+
+		if (node.IsLeaf())
+		{
+			UpdateNodeBounds(nodeIndex, primitiveBounds);
+			return;
+		}
+
+		node.bounds = m_Nodes[node.leftFirst].bounds;
+		node.bounds.Grow(m_Nodes[node.leftFirst + 1].bounds);
+	}
+
+	void BVH::RefitSubtree(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds)
+	{
+		const BVHNode& node{ m_Nodes[nodeIndex] };
+
+		if (!node.IsLeaf())
+		{
+			RefitSubtree(node.leftFirst, primitiveBounds);
+			RefitSubtree(node.leftFirst + 1, primitiveBounds);
+		}
+
+		RefitNode(nodeIndex, primitiveBounds);
+	}
+
+	void BVH::Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds)
+	{
+		m_Stats.maxDepth = std::max(m_Stats.maxDepth, depth);
+
+		// Copy, the node reference would dangle once children are pushed
+		const BVHNode node{ m_Nodes[nodeIndex] };
+
+		int axis{};
+		float splitPosition{};
+		const float splitCost{ FindBestSplit(node, primitiveBounds, axis, splitPosition) };
+		const float leafCost{ IntersectionCost * node.primitiveCount * node.bounds.HalfArea() };
+
+		if (node.primitiveCount <= 1 || depth >= MaxDepth || splitCost >= leafCost)
+		{
+			++m_Stats.leafCount;
+			return;
+		}
+
+		// Partition the primitive indices around the split plane
+		const auto first{ m_PrimitiveIndices.begin() + node.leftFirst };
+		const auto last{ first + node.primitiveCount };
+		const auto middle{ std::partition(first, last, [&](uint32_t primitiveIndex)
+			{
+				return m_Centroids[primitiveIndex][axis] < splitPosition;
+			}) };
+
+		const uint32_t leftCount{ static_cast<uint32_t>(middle - first) };
+		if (leftCount == 0 || leftCount == node.primitiveCount)
+		{
+			++m_Stats.leafCount;
+			return;
+		}
+
+		const uint32_t leftIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes.emplace_back(BVHNode{ {}, node.leftFirst, leftCount });
+		m_Nodes.emplace_back(BVHNode{ {}, node.leftFirst + leftCount, node.primitiveCount - leftCount });
+
+		m_Nodes[nodeIndex].leftFirst = leftIndex;
+		m_Nodes[nodeIndex].primitiveCount = 0;
+
+		UpdateNodeBounds(leftIndex, primitiveBounds);
+		UpdateNodeBounds(leftIndex + 1, primitiveBounds);
+
+		Subdivide(leftIndex, depth + 1, primitiveBounds);
+		Subdivide(leftIndex + 1, depth + 1, primitiveBounds);
+	}
+
+	float BVH::FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, int& axis, float& splitPosition) const
+	{
+		struct Bin
+		{
+			AABB bounds{};
+			uint32_t count{};
+		};
+
+		float bestCost{ FLT_MAX };
+
+		// Bin over the centroid bounds, primitive bounds would waste bins on large triangles
+		AABB centroidBounds{};
+		for (uint32_t index{}; index < node.primitiveCount; ++index)
+			centroidBounds.Grow(m_Centroids[m_PrimitiveIndices[node.leftFirst + index]]);
+
+		for (int currentAxis{}; currentAxis < 3; ++currentAxis)
+		{
+			const float boundsMin{ centroidBounds.minAABB[currentAxis] };
+			const float boundsMax{ centroidBounds.maxAABB[currentAxis] };
+
+			if (boundsMin == boundsMax)
+				continue;
+
+			Bin bins[BinCount]{};
+			const float scale{ BinCount / (boundsMax - boundsMin) };
+
+			for (uint32_t index{}; index < node.primitiveCount; ++index)
+			{
+				const uint32_t primitiveIndex{ m_PrimitiveIndices[node.leftFirst + index] };
+				const int binIndex{ std::min(BinCount - 1, static_cast<int>((m_Centroids[primitiveIndex][currentAxis] - boundsMin) * scale)) };
+
+				++bins[binIndex].count;
+				bins[binIndex].bounds.Grow(primitiveBounds[primitiveIndex]);
+			}
+
+			// Sweep from both sides to get the area and count left and right of every plane
+			float leftArea[BinCount - 1]{}, rightArea[BinCount - 1]{};
+			uint32_t leftCount[BinCount - 1]{}, rightCount[BinCount - 1]{};
+
+			AABB leftBounds{}, rightBounds{};
+			uint32_t leftSum{}, rightSum{};
+
+			for (int index{}; index < BinCount - 1; ++index)
+			{
+				leftSum += bins[index].count;
+				leftCount[index] = leftSum;
+				leftBounds.Grow(bins[index].bounds);
+				leftArea[index] = leftBounds.HalfArea();
+
+				rightSum += bins[BinCount - 1 - index].count;
+				rightCount[BinCount - 2 - index] = rightSum;
+				rightBounds.Grow(bins[BinCount - 1 - index].bounds);
+				rightArea[BinCount - 2 - index] = rightBounds.HalfArea();
+			}
+
+			const float binWidth{ 1.f / scale };
+			for (int index{}; index < BinCount - 1; ++index)
+			{
+				const float planeCost{ TraversalCost * node.bounds.HalfArea() +
+					IntersectionCost * (leftCount[index] * leftArea[index] + rightCount[index] * rightArea[index]) };
+
+				if (planeCost < bestCost)
+				{
+					axis = currentAxis;
+					splitPosition = boundsMin + binWidth * (index + 1);
+					bestCost = planeCost;
+				}
+			}
+		}
+
+		return bestCost;
+	}
+
+	void WideBVH::Build(const BVH& bvh)
+	{
+		Clear();
+		if (bvh.IsEmpty())
+			return;
+
+		const BVHNode& root{ bvh.GetNodes()[0] };
+		if (!root.IsLeaf())
+		{
+			CollapseNode(bvh, 0);
+			return;
+		}
+
+		// A single leaf still needs a wide node around it
+		WideBVHNode& wideRoot{ m_Nodes.emplace_back() };
+		wideRoot.childCount = 1;
+		wideRoot.child[0] = root.leftFirst;
+		wideRoot.primitiveCount[0] = root.primitiveCount;
+		SetChildBounds(wideRoot, 0, root.bounds);
+
+		m_BinaryChildren.assign(Width, 0);
+	}
+
+	void WideBVH::Refit(const BVH& bvh)
+	{
+		const std::vector<BVHNode>& binaryNodes{ bvh.GetNodes() };
+
+		for (uint32_t nodeIndex{}; nodeIndex < m_Nodes.size(); ++nodeIndex)
+		{
+			WideBVHNode& node{ m_Nodes[nodeIndex] };
+
+			for (uint32_t slot{}; slot < node.childCount; ++slot)
+				SetChildBounds(node, slot, binaryNodes[m_BinaryChildren[nodeIndex * Width + slot]].bounds);
+		}
+	}
+
+	uint32_t WideBVH::CollapseNode(const BVH& bvh, uint32_t binaryIndex)
+	{
+		const std::vector<BVHNode>& binaryNodes{ bvh.GetNodes() };
+		const uint32_t wideIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes.emplace_back();
+		m_BinaryChildren.resize(m_BinaryChildren.size() + Width);
+
+		// Open the largest inner child until the node is full
+		uint32_t children[Width]{ binaryNodes[binaryIndex].leftFirst, binaryNodes[binaryIndex].leftFirst + 1 };
+		uint32_t childCount{ 2 };
+
+		while (childCount < Width)
+		{
+			int largestSlot{ -1 };
+			float largestArea{ -1.f };
+
+			for (uint32_t slot{}; slot < childCount; ++slot)
+			{
+				const BVHNode& child{ binaryNodes[children[slot]] };
+				if (!child.IsLeaf() && child.bounds.HalfArea() > largestArea)
+				{
+					largestArea = child.bounds.HalfArea();
+					largestSlot = static_cast<int>(slot);
+				}
+			}
+
+			if (largestSlot < 0)
+				break;
+
+			const uint32_t opened{ children[largestSlot] };
+			children[largestSlot] = binaryNodes[opened].leftFirst;
+			children[childCount++] = binaryNodes[opened].leftFirst + 1;
+		}
+
+		// Recurse first, pushing nodes can move the vector
+		uint32_t wideChildren[Width]{};
+		for (uint32_t slot{}; slot < childCount; ++slot)
+		{
+			const BVHNode& child{ binaryNodes[children[slot]] };
+			wideChildren[slot] = child.IsLeaf() ? child.leftFirst : CollapseNode(bvh, children[slot]);
+		}
+
+		WideBVHNode& node{ m_Nodes[wideIndex] };
+		node.childCount = childCount;
+
+		for (uint32_t slot{}; slot < Width; ++slot)
+		{
+			if (slot >= childCount)
+			{
+				// Unused slots are masked out by childCount, give them a degenerate box anyway
+				SetChildBounds(node, slot, { Vector3::Zero, Vector3::Zero });
+				node.child[slot] = 0;
+				node.primitiveCount[slot] = 0;
+				continue;
+			}
+
+			const BVHNode& child{ binaryNodes[children[slot]] };
+			SetChildBounds(node, slot, child.bounds);
+			m_BinaryChildren[wideIndex * Width + slot] = children[slot];
+			node.child[slot] = wideChildren[slot];
+			node.primitiveCount[slot] = child.primitiveCount;
+		}
+
+		return wideIndex;
+	}
+
+	void WideBVH::SetChildBounds(WideBVHNode& node, uint32_t slot, const AABB& bounds)
+	{
+		node.minX[slot] = bounds.minAABB.x;
+		node.minY[slot] = bounds.minAABB.y;
+		node.minZ[slot] = bounds.minAABB.z;
+		node.maxX[slot] = bounds.maxAABB.x;
+		node.maxY[slot] = bounds.maxAABB.y;
+		node.maxZ[slot] = bounds.maxAABB.z;
+	}
+}
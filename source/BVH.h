@@ -0,0 +1,200 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct AABB
+	{
+		Vector3 minAABB{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maxAABB{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& point)
+		{
+			minAABB = Vector3::Min(minAABB, point);
+			maxAABB = Vector3::Max(maxAABB, point);
+		}
+
+		void Grow(const AABB& other)
+		{
+			minAABB = Vector3::Min(minAABB, other.minAABB);
+			maxAABB = Vector3::Max(maxAABB, other.maxAABB);
+		}
+
+		Vector3 Center() const
+		{
+			return (minAABB + maxAABB) * 0.5f;
+		}
+
+		bool operator==(const AABB& other) const = default;
+
+		// Half of the surface area, the constant factor drops out of every SAH ratio
+		float HalfArea() const
+		{
+			if (minAABB.x > maxAABB.x)
+				return 0.f;
+
+			const Vector3 extent{ maxAABB - minAABB };
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct BVHNode
+	{
+		AABB bounds{};
+
+		// Leaf: index of the first primitive in the primitive index list
+		// Inner node: index of the left child, the right child is stored right after it
+		uint32_t leftFirst{};
+		uint32_t primitiveCount{};
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	enum class BVHTraversalMode
+	{
+		Binary,	// scalar slab test, one child at a time
+		Wide	// four children per node, tested together with SIMD
+	};
+
+	struct BVHStats
+	{
+		uint32_t nodeCount{};
+		uint32_t leafCount{};
+		uint32_t maxDepth{};
+		uint32_t primitiveCount{};
+		float sahCost{};
+		float buildTimeMs{};
+	};
+
+	/**
+	 * \brief Binary bounding volume hierarchy built with the binned surface area heuristic.
+	 * The hierarchy only knows about primitive bounds, the owner maps the primitive indices
+	 * back to its own geometry when traversing (see GeometryUtils::TraverseBVH)
+	 */
+	class BVH final
+	{
+	public:
+		static constexpr uint32_t MaxDepth{ 64 };
+		static constexpr int BinCount{ 12 };
+
+		void Build(const std::vector<AABB>& primitiveBounds);
+		void Clear();
+
+		/**
+		 * \brief Recalculates the node bounds bottom-up for primitives that moved, the topology stays untouched.
+		 * Large trees refit their subtrees in parallel
+		 * \return false when the SAH cost degraded past the rebuild threshold, the caller should Build again
+		 */
+		bool Refit(const std::vector<AABB>& primitiveBounds);
+
+		//Refits when possible, falls back to a full build for new or degraded trees
+		//Returns true when it refitted, the nodes and the primitive index list are laid out as before then
+		bool Update(const std::vector<AABB>& primitiveBounds);
+
+		void SetRebuildThreshold(float threshold) { m_RebuildThreshold = threshold; }
+
+		float CalculateSAHCost() const;
+		float GetQualityRatio() const { return m_Stats.sahCost > 0.f ? m_CurrentSAHCost / m_Stats.sahCost : 1.f; }
+		void PrintStats(const std::string& name) const;
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		const AABB& GetBounds() const { return m_Nodes[0].bounds; }
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+		const BVHStats& GetStats() const { return m_Stats; }
+
+	private:
+		void UpdateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds);
+		void Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds);
+		float FindBestSplit(const BVHNode& node, const std::vector<AABB>& primitiveBounds, int& axis, float& splitPosition) const;
+
+		void PrepareRefit();
+		void RefitNode(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds);
+		void RefitSubtree(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds);
+
+		// Cost of testing a node relative to intersecting a single primitive
+		static constexpr float TraversalCost{ 1.f };
+		static constexpr float IntersectionCost{ 1.f };
+
+		// Below this many primitives spawning refit tasks costs more than it saves
+		static constexpr uint32_t ParallelRefitThreshold{ 8192 };
+		static constexpr uint32_t RefitTaskCount{ 64 };
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_PrimitiveIndices{};
+		std::vector<Vector3> m_Centroids{};
+		BVHStats m_Stats{};
+
+		// Subtrees refitted in parallel and the nodes above them in bottom-up order
+		std::vector<uint32_t> m_RefitSubtreeRoots{};
+		std::vector<uint32_t> m_RefitTopNodes{};
+
+		float m_CurrentSAHCost{};
+		float m_RebuildThreshold{ 1.5f };
+	};
+
+	//Node of the 4-wide hierarchy, child bounds are stored per axis so they can be loaded as one vector
+	struct alignas(16) WideBVHNode
+	{
+		float minX[4];
+		float minY[4];
+		float minZ[4];
+		float maxX[4];
+		float maxY[4];
+		float maxZ[4];
+
+		// Leaf child: index of the first primitive (or whatever RemapLeaves pointed it at), inner child: index of the wide node
+		uint32_t child[4];
+		// 0 for inner children
+		uint32_t primitiveCount[4];
+		uint32_t childCount;
+	};
+
+	/**
+	 * \brief 4-wide hierarchy collapsed from a binary BVH, it shares the primitive index list of that BVH.
+	 * Every wide node pulls up the grandchildren of the binary children with the largest surface area
+	 */
+	class WideBVH final
+	{
+	public:
+		static constexpr uint32_t Width{ 4 };
+
+		void Build(const BVH& bvh);
+		//Takes the bounds over from bvh again after it was refitted, the nodes stay as Build collapsed them
+		void Refit(const BVH& bvh);
+		void Clear()
+		{
+			m_Nodes.clear();
+			m_BinaryChildren.clear();
+		}
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		const std::vector<WideBVHNode>& GetNodes() const { return m_Nodes; }
+
+		//Lets the owner point the leaves at its own primitive storage, remap(first, count) may change both
+		template<typename RemapLeaf>
+		void RemapLeaves(RemapLeaf&& remap)
+		{
+			for (WideBVHNode& node : m_Nodes)
+			{
+				for (uint32_t slot{}; slot < node.childCount; ++slot)
+				{
+					if (node.primitiveCount[slot] > 0)
+						remap(node.child[slot], node.primitiveCount[slot]);
+				}
+			}
+		}
+
+	private:
+		uint32_t CollapseNode(const BVH& bvh, uint32_t binaryIndex);
+		static void SetChildBounds(WideBVHNode& node, uint32_t slot, const AABB& bounds);
+
+		std::vector<WideBVHNode> m_Nodes{};
+		//Binary node every child slot was made from, Width per wide node
+		std::vector<uint32_t> m_BinaryChildren{};
+	};
+}
@@ -16,12 +16,19 @@ namespace dae
 				*this /= maxValue;
 		}
 
+		float MaxComponent() const
+		{
+			return std::max(r, std::max(g, b));
+		}
+
 		static ColorRGB Lerp(const ColorRGB& c1, const ColorRGB& c2, float factor)
 		{
 			return { Lerpf(c1.r, c2.r, factor), Lerpf(c1.g, c2.g, factor), Lerpf(c1.b, c2.b, factor) };
 		}
 
 		#pragma region ColorRGB (Member) Operators
+		bool operator==(const ColorRGB& c) const = default;
+
 		const ColorRGB& operator+=(const ColorRGB& c)
 		{
 			r += c.r;
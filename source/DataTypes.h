@@ -1,6 +1,13 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <memory>
 
+#include "BVH.h"
 #include "Math.h"
 #include "vector"
 
@@ -56,62 +63,312 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
-	struct TriangleMesh
+	//Intersection ready copy of a mesh triangle, the edges are only recalculated when the geometry changes
+	struct TriangleRecord
 	{
-		TriangleMesh() = default;
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode):
-		positions(_positions), indices(_indices), cullMode(_cullMode)
+		Vector3 v0{};
+		Vector3 edge1{};
+		Vector3 edge2{};
+		Vector3 normal{};
+	};
+
+	//Four triangles in SoA layout so they can be intersected with one SIMD Moller-Trumbore
+	struct alignas(16) TriangleBlock
+	{
+		static constexpr uint32_t Width{ 4 };
+		static constexpr uint32_t InvalidTriangle{ UINT32_MAX };
+
+		float v0X[Width];
+		float v0Y[Width];
+		float v0Z[Width];
+		float edge1X[Width];
+		float edge1Y[Width];
+		float edge1Z[Width];
+		float edge2X[Width];
+		float edge2Y[Width];
+		float edge2Z[Width];
+		float normalX[Width];
+		float normalY[Width];
+		float normalZ[Width];
+
+		// Index into the mesh triangles, padding lanes are InvalidTriangle and have zero sized edges
+		uint32_t triangleIndex[Width];
+
+		void SetTriangle(uint32_t lane, uint32_t index, const TriangleRecord& record)
 		{
-			//Calculate Normals
-			CalculateNormals();
+			v0X[lane] = record.v0.x;
+			v0Y[lane] = record.v0.y;
+			v0Z[lane] = record.v0.z;
+			edge1X[lane] = record.edge1.x;
+			edge1Y[lane] = record.edge1.y;
+			edge1Z[lane] = record.edge1.z;
+			edge2X[lane] = record.edge2.x;
+			edge2Y[lane] = record.edge2.y;
+			edge2Z[lane] = record.edge2.z;
+			normalX[lane] = record.normal.x;
+			normalY[lane] = record.normal.y;
+			normalZ[lane] = record.normal.z;
+			triangleIndex[lane] = index;
+		}
+	};
 
-			//Update Transforms
-			UpdateTransforms();
+	//Position quantized to 16 bits per axis, 0 and UINT16_MAX are the minimum and maximum of its mesh on that axis
+	struct QuantizedPosition
+	{
+		uint16_t x{};
+		uint16_t y{};
+		uint16_t z{};
+	};
+
+	/**
+	 * \brief Triangles of a compacted MeshGeometry at 6 bytes per vertex, 4 per normal (8 when they aren't unit length) and 2 or 4 per index.
+	 * Nothing is decoded up front, the intersection code decodes the triangles it visits one at a time
+	 */
+	struct CompactTriangles
+	{
+		//Meshes with at most this many vertices store their indices in 16 bits
+		static constexpr size_t MaxSmallIndexVertexCount{ size_t{ UINT16_MAX } + 1 };
+		//Normals whose squared length is this close to 1 count as unit length, a few float roundings of a normalized vector
+		static constexpr float UnitLengthTolerance{ 1e-5f };
+
+		std::vector<QuantizedPosition> positions{};
+		//One per triangle, octahedral encoded as two snorm16 with x in the low half
+		std::vector<uint32_t> normals{};
+		//Length of every normal, empty when they all have unit length. The direction is all the encoding keeps,
+		//meshes with CalculateNormals normals would shade differently once compacted without it
+		std::vector<float> normalLengths{};
+		//Three per triangle, only one of the two is filled
+		std::vector<uint16_t> smallIndices{};
+		std::vector<uint32_t> indices{};
+
+		//A position decodes to origin + quantized * step on every axis
+		Vector3 origin{};
+		Vector3 step{};
+
+		void Encode(const std::vector<Vector3>& sourcePositions, const std::vector<Vector3>& sourceNormals, const std::vector<int>& sourceIndices)
+		{
+			AABB bounds{};
+			for (const Vector3& position : sourcePositions)
+				bounds.Grow(position);
+
+			origin = sourcePositions.empty() ? Vector3{} : bounds.minAABB;
+			step = sourcePositions.empty() ? Vector3{} : (bounds.maxAABB - bounds.minAABB) / static_cast<float>(UINT16_MAX);
+
+			positions.resize(sourcePositions.size());
+			std::transform(std::execution::par, sourcePositions.begin(), sourcePositions.end(), positions.begin(),
+				[this](const Vector3& position)
+				{
+					return QuantizedPosition{ Quantize(position.x, origin.x, step.x), Quantize(position.y, origin.y, step.y), Quantize(position.z, origin.z, step.z) };
+				});
+
+			normals.resize(sourceNormals.size());
+			std::transform(std::execution::par, sourceNormals.begin(), sourceNormals.end(), normals.begin(), EncodeNormal);
+
+			normalLengths.clear();
+			const bool hasUnitNormals{ std::all_of(std::execution::par, sourceNormals.begin(), sourceNormals.end(),
+				[](const Vector3& normal) { return std::abs(normal.SqrMagnitude() - 1.f) <= UnitLengthTolerance; }) };
+			if (!hasUnitNormals)
+			{
+				normalLengths.resize(sourceNormals.size());
+				std::transform(std::execution::par, sourceNormals.begin(), sourceNormals.end(), normalLengths.begin(),
+					[](const Vector3& normal) { return normal.Magnitude(); });
+			}
+
+			smallIndices.clear();
+			indices.clear();
+			if (sourcePositions.size() <= MaxSmallIndexVertexCount)
+			{
+				smallIndices.resize(sourceIndices.size());
+				std::transform(sourceIndices.begin(), sourceIndices.end(), smallIndices.begin(), [](int index) { return static_cast<uint16_t>(index); });
+			}
+			else
+			{
+				indices.assign(sourceIndices.begin(), sourceIndices.end());
+			}
 		}
 
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
-			positions(_positions), indices(_indices), normals(_normals), cullMode(_cullMode)
+		int GetTriangleCount() const { return static_cast<int>((smallIndices.size() + indices.size()) / 3); }
+
+		uint32_t GetIndex(size_t index) const
+		{
+			return smallIndices.empty() ? indices[index] : smallIndices[index];
+		}
+
+		Vector3 GetPosition(uint32_t vertex) const
+		{
+			const QuantizedPosition& position{ positions[vertex] };
+			return { origin.x + position.x * step.x, origin.y + position.y * step.y, origin.z + position.z * step.z };
+		}
+
+		Vector3 GetNormal(int triangleIndex) const
+		{
+			const Vector3 direction{ DecodeNormal(normals[triangleIndex]) };
+			return normalLengths.empty() ? direction : direction * normalLengths[triangleIndex];
+		}
+
+		TriangleRecord GetTriangleRecord(int triangleIndex) const
+		{
+			const size_t offset{ static_cast<size_t>(triangleIndex) * 3 };
+			const Vector3 v0{ GetPosition(GetIndex(offset)) };
+
+			return { v0, GetPosition(GetIndex(offset + 1)) - v0, GetPosition(GetIndex(offset + 2)) - v0, GetNormal(triangleIndex) };
+		}
+
+		//Decodes count triangles (at most TriangleBlock::Width) into the lanes of block, the lanes after them are padding
+		void GetTriangleBlock(const uint32_t* pTriangleIndices, uint32_t count, TriangleBlock& block) const
+		{
+			for (uint32_t lane{}; lane < TriangleBlock::Width; ++lane)
+			{
+				const TriangleRecord record{ lane < count ? GetTriangleRecord(static_cast<int>(pTriangleIndices[lane])) : TriangleRecord{} };
+
+				block.v0X[lane] = record.v0.x;
+				block.v0Y[lane] = record.v0.y;
+				block.v0Z[lane] = record.v0.z;
+				block.edge1X[lane] = record.edge1.x;
+				block.edge1Y[lane] = record.edge1.y;
+				block.edge1Z[lane] = record.edge1.z;
+				block.edge2X[lane] = record.edge2.x;
+				block.edge2Y[lane] = record.edge2.y;
+				block.edge2Z[lane] = record.edge2.z;
+				block.normalX[lane] = record.normal.x;
+				block.normalY[lane] = record.normal.y;
+				block.normalZ[lane] = record.normal.z;
+				block.triangleIndex[lane] = lane < count ? pTriangleIndices[lane] : TriangleBlock::InvalidTriangle;
+			}
+		}
+
+		static uint16_t Quantize(float value, float origin, float step)
+		{
+			if (step <= 0.f)
+				return 0;
+
+			return static_cast<uint16_t>(std::clamp(std::round((value - origin) / step), 0.f, static_cast<float>(UINT16_MAX)));
+		}
+
+		//The sphere is projected onto an octahedron and its lower half folded over the upper one, the square that leaves is stored
+		static uint32_t EncodeNormal(const Vector3& normal)
+		{
+			const float length{ std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) };
+			// degenerate triangles have no direction, they decode to +z
+			if (length <= 0.f)
+				return 0;
+
+			float x{ normal.x / length };
+			float y{ normal.y / length };
+			if (normal.z < 0.f)
+			{
+				const float foldedX{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+				y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+				x = foldedX;
+			}
+
+			const auto toSnorm{ [](float value) { return static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * INT16_MAX))); } };
+			return toSnorm(x) | static_cast<uint32_t>(toSnorm(y)) << 16;
+		}
+
+		static Vector3 DecodeNormal(uint32_t encoded)
+		{
+			float x{ static_cast<int16_t>(encoded & 0xFFFF) / static_cast<float>(INT16_MAX) };
+			float y{ static_cast<int16_t>(encoded >> 16) / static_cast<float>(INT16_MAX) };
+			const float z{ 1.f - std::abs(x) - std::abs(y) };
+
+			if (z < 0.f)
+			{
+				const float unfoldedX{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+				y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+				x = unfoldedX;
+			}
+
+			return Vector3{ x, y, z }.Normalized();
+		}
+	};
+
+	//Vertex data shared by every TriangleMesh instance that places it in the scene
+	struct MeshGeometry
+	{
+		MeshGeometry() = default;
+		MeshGeometry(const std::vector<Vector3>& _positions, const std::vector<int>& _indices) :
+			positions(_positions), indices(_indices)
+		{
+			CalculateNormals();
+		}
+
+		MeshGeometry(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals) :
+			positions(_positions), normals(_normals), indices(_indices)
 		{
-			UpdateTransforms();
 		}
 
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
-
-		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
-
-		Matrix rotationTransform{};
-		Matrix translationTransform{};
-		Matrix scaleTransform{};
 
 		Vector3 minAABB{};
 		Vector3 maxAABB{};
 
-		Vector3 transformedMinAABB{};
-		Vector3 transformedMaxAABB{};
+		//Hierarchy over the triangles, primitive index == triangle index
+		BVH bvh{};
+		//Same hierarchy collapsed to 4 children per node for the SIMD traversal
+		//Its leaves point at triangleBlocks instead of triangles
+		WideBVH wideBVH{};
+		std::vector<TriangleBlock> triangleBlocks{};
 
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
+		//Indexed like the triangles, rebuilt together with the hierarchies
+		std::vector<TriangleRecord> triangleRecords{};
 
-		void Translate(const Vector3& translation)
+		//Replaces positions, normals, indices, the triangle records and the triangle blocks after Compact
+		CompactTriangles compact{};
+		bool isCompact{ false };
+
+		//Bumped whenever triangles are added or the hierarchy is rebuilt, instances compare it to the one they last saw
+		uint32_t version{ 1 };
+
+		int GetTriangleCount() const { return isCompact ? compact.GetTriangleCount() : static_cast<int>(indices.size() / 3); }
+
+		//Corner 0, 1 or 2 of a triangle, decoded on the spot for compact geometry
+		Vector3 GetVertex(int triangleIndex, int corner) const
 		{
-			translationTransform = Matrix::CreateTranslation(translation);
+			const size_t offset{ static_cast<size_t>(triangleIndex) * 3 + corner };
+			return isCompact ? compact.GetPosition(compact.GetIndex(offset)) : positions[indices[offset]];
 		}
 
-		void RotateY(float yaw)
+		Vector3 GetNormal(int triangleIndex) const
 		{
-			rotationTransform = Matrix::CreateRotationY(yaw);
+			return isCompact ? compact.GetNormal(triangleIndex) : normals[triangleIndex];
 		}
 
-		void Scale(const Vector3& scale)
+		TriangleRecord GetTriangleRecord(int triangleIndex) const
 		{
-			scaleTransform = Matrix::CreateScale(scale);
+			return isCompact ? compact.GetTriangleRecord(triangleIndex) : triangleRecords[triangleIndex];
 		}
 
-		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
+		/**
+		 * \brief Quantizes the triangles into compact and frees the float arrays, the triangle records and the triangle blocks.
+		 * Vertices snap to 1/65535th of the mesh bounds on every axis and normals stay within a few hundredths of a degree, the
+		 * triangle data takes about a tenth of the memory. Rays pay for it by decoding every triangle they test.
+		 * Compact geometry can't be edited anymore
+		 */
+		void Compact()
 		{
+			if (isCompact)
+				return;
+
+			compact.Encode(positions, normals, indices);
+			isCompact = true;
+
+			std::vector<Vector3>().swap(positions);
+			std::vector<Vector3>().swap(normals);
+			std::vector<int>().swap(indices);
+			std::vector<TriangleRecord>().swap(triangleRecords);
+			std::vector<TriangleBlock>().swap(triangleBlocks);
+
+			//The hierarchy has to enclose the decoded triangles rather than the original ones
+			BuildBVH();
+		}
+
+		void AppendTriangle(const Triangle& triangle)
+		{
+			assert(!isCompact && "Compact geometry can't be appended to");
+
 			int startIndex = static_cast<int>(positions.size());
 
 			positions.push_back(triangle.v0);
@@ -123,16 +380,13 @@ namespace dae
 			indices.push_back(++startIndex);
 
 			normals.push_back(triangle.normal);
-
-			//Not ideal, but making sure all vertices are updated
-			if(!ignoreTransformUpdate)
-				UpdateTransforms();
+			++version;
 		}
 
 		void CalculateNormals()
 		{
 			constexpr int nrVertices{ 3 };
-			const int nrTriangles{ static_cast<int>(indices.size() / nrVertices) };
+			const int nrTriangles{ GetTriangleCount() };
 
 			for (int index{}; index < nrTriangles; ++index)
 			{
@@ -146,39 +400,146 @@ namespace dae
 			}
 		}
 
-		void UpdateTransforms()
+		//Only needed when the hierarchy is out of date, instances build it on their first UpdateTransforms
+		bool NeedsBVHBuild() const
+		{
+			return bvh.GetStats().primitiveCount != static_cast<uint32_t>(GetTriangleCount());
+		}
+
+		//Full rebuild, needed after positions or indices were edited in place
+		void BuildBVH()
 		{
-			ReserveSpace();
+			std::vector<AABB> triangleBounds{};
+			CalculateTriangleBounds(triangleBounds);
+			bvh.Build(triangleBounds);
+			BuildTriangleRecords();
+			BuildWideBVH();
 
-			//Calculate Final Transform 
-			//const auto finalTransform = ...
-			const Matrix finalTransform{ scaleTransform * rotationTransform * translationTransform };
+			UpdateAABB();
+			++version;
+		}
 
-			//Transform Positions (positions > transformedPositions)
-			//...
-			for (int index{}; index < static_cast<int>(positions.size()); ++index)
-				transformedPositions[index] = finalTransform.TransformPoint(positions[index]);
+		//Refit after the positions moved, the hierarchy rebuilds itself once it degraded too much
+		void UpdateBVH(std::vector<AABB>& triangleBounds)
+		{
+			CalculateTriangleBounds(triangleBounds);
+			const bool isRefitted{ bvh.Update(triangleBounds) };
+			BuildTriangleRecords();
+
+			//The binary topology didn't change, neither did the wide nodes or which triangle sits in which block lane
+			if (isRefitted && !wideBVH.IsEmpty())
+				RefitWideBVH();
+			else
+				BuildWideBVH();
+		}
 
-			//Transform Normals (normals > transformedNormals)
-			//...
-			for (int index{}; index < static_cast<int>(normals.size()); ++index)
-				transformedNormals[index] = rotationTransform.TransformVector(normals[index]);
+		void BuildTriangleRecords()
+		{
+			//Compact geometry decodes its records while tracing
+			if (isCompact)
+				return;
 
-			UpdateAABB();
-			UpdateTransformedAABB(finalTransform);
+			triangleRecords.resize(GetTriangleCount());
+
+			for (size_t triangleIndex{}; triangleIndex < triangleRecords.size(); ++triangleIndex)
+			{
+				const Vector3& v0{ positions[indices[triangleIndex * 3]] };
+
+				TriangleRecord& record{ triangleRecords[triangleIndex] };
+				record.v0 = v0;
+				record.edge1 = positions[indices[triangleIndex * 3 + 1]] - v0;
+				record.edge2 = positions[indices[triangleIndex * 3 + 2]] - v0;
+				record.normal = normals[triangleIndex];
+			}
 		}
 
-		void ReserveSpace()
+		void BuildWideBVH()
 		{
-			if (transformedNormals.size() != normals.size())
-				transformedNormals.resize(normals.size());
-			if (transformedPositions.size() != positions.size())
-				transformedPositions.resize(positions.size());
+			constexpr uint32_t width{ TriangleBlock::Width };
+			const std::vector<uint32_t>& triangleOrder{ bvh.GetPrimitiveIndices() };
+
+			wideBVH.Build(bvh);
+			triangleBlocks.clear();
+
+			//Compact leaves keep pointing into the primitive indices of bvh, their blocks are decoded while tracing
+			if (isCompact)
+				return;
+
+			//Every leaf gets its own blocks, the last one padded with empty lanes
+			wideBVH.RemapLeaves([&](uint32_t& first, uint32_t& count)
+				{
+					const uint32_t firstBlock{ static_cast<uint32_t>(triangleBlocks.size()) };
+
+					for (uint32_t blockStart{}; blockStart < count; blockStart += width)
+					{
+						TriangleBlock& block{ triangleBlocks.emplace_back() };
+
+						for (uint32_t lane{}; lane < width; ++lane)
+						{
+							if (blockStart + lane >= count)
+							{
+								block.triangleIndex[lane] = TriangleBlock::InvalidTriangle;
+								continue;
+							}
+
+							const uint32_t triangleIndex{ triangleOrder[first + blockStart + lane] };
+							block.SetTriangle(lane, triangleIndex, triangleRecords[triangleIndex]);
+						}
+					}
+
+					first = firstBlock;
+					count = static_cast<uint32_t>(triangleBlocks.size()) - firstBlock;
+				});
+		}
+
+		//BuildWideBVH for a bvh that was only refitted since, the node bounds and block lanes are rewritten in place
+		void RefitWideBVH()
+		{
+			wideBVH.Refit(bvh);
+
+			if (isCompact)
+				return;
+
+			for (TriangleBlock& block : triangleBlocks)
+			{
+				for (uint32_t lane{}; lane < TriangleBlock::Width; ++lane)
+				{
+					const uint32_t triangleIndex{ block.triangleIndex[lane] };
+					if (triangleIndex != TriangleBlock::InvalidTriangle)
+						block.SetTriangle(lane, triangleIndex, triangleRecords[triangleIndex]);
+				}
+			}
+		}
+
+		void CalculateTriangleBounds(std::vector<AABB>& triangleBounds) const
+		{
+			const int nrTriangles{ GetTriangleCount() };
+
+			triangleBounds.resize(nrTriangles);
+			for (int index{}; index < nrTriangles; ++index)
+			{
+				triangleBounds[index] = {};
+				triangleBounds[index].Grow(GetVertex(index, 0));
+				triangleBounds[index].Grow(GetVertex(index, 1));
+				triangleBounds[index].Grow(GetVertex(index, 2));
+			}
 		}
 
 		void UpdateAABB()
 		{
-			if (!positions.empty())
+			if (isCompact)
+			{
+				AABB bounds{};
+				for (uint32_t vertex{}; vertex < compact.positions.size(); ++vertex)
+					bounds.Grow(compact.GetPosition(vertex));
+
+				if (!compact.positions.empty())
+				{
+					minAABB = bounds.minAABB;
+					maxAABB = bounds.maxAABB;
+				}
+			}
+			else if (!positions.empty())
 			{
 				minAABB = positions[0];
 				maxAABB = positions[0];
@@ -189,9 +550,315 @@ namespace dae
 				}
 			}
 		}
+	};
+
+	//Placement of a MeshGeometry in the scene, many instances can share the same geometry
+	struct TriangleMesh
+	{
+		TriangleMesh() = default;
+		TriangleMesh(const std::shared_ptr<MeshGeometry>& _pGeometry, TriangleCullMode _cullMode) :
+			pGeometry(_pGeometry), cullMode(_cullMode)
+		{
+			//Update Transforms
+			UpdateTransforms();
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode):
+			TriangleMesh(std::make_shared<MeshGeometry>(_positions, _indices), _cullMode)
+		{
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
+			TriangleMesh(std::make_shared<MeshGeometry>(_positions, _indices, _normals), _cullMode)
+		{
+		}
+
+		//Empty for a default constructed mesh, whoever creates it hands it a geometry (see Scene::AddTriangleMesh)
+		std::shared_ptr<MeshGeometry> pGeometry{};
+		unsigned char materialIndex{};
+
+		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+		//World transform of the scene graph node the mesh hangs from, applied after the three above
+		Matrix parentTransform{};
+
+		//Rigid meshes are traced in object space, rays get moved by the inverse transform
+		//Non-rigid meshes keep a private world space copy of the geometry instead
+		bool isRigid{ true };
+		Matrix worldTransform{};
+		Matrix inverseWorldTransform{};
+		//Rotation of the mesh and its node together, turns object space normals into world space ones
+		Matrix normalTransform{};
+
+		Vector3 transformedMinAABB{};
+		Vector3 transformedMaxAABB{};
+
+		std::shared_ptr<MeshGeometry> pWorldGeometry{};
+		//Scratch for the triangle bounds of pWorldGeometry, kept so refitting it every frame doesn't allocate
+		std::vector<AABB> worldTriangleBounds{};
+		//Compact geometry decoded for pWorldGeometry, empty for plain geometry
+		std::vector<Vector3> decodedPositions{};
+		std::vector<Vector3> decodedNormals{};
+
+		//Fewer vertices than this are transformed on the calling thread
+		static constexpr uint32_t ParallelTransformThreshold{ 16384 };
+		//Vertices per task once a transform is split over the cores, whole batches of Vector3x8::Size
+		static constexpr uint32_t TransformChunkSize{ 4096 };
+
+		//Geometry the rays get traced against, in object space for rigid meshes and world space otherwise
+		const MeshGeometry& GetTracedGeometry() const
+		{
+			return isRigid ? *pGeometry : *pWorldGeometry;
+		}
+
+		//Bumped by every change to the placement, the world transform and everything derived from it are only
+		//recalculated for a version they haven't seen yet. Write the transforms through the setters below to keep it in sync
+		uint32_t transformVersion{ 1 };
+		//Versions of the placement and the geometry that worldTransform, the world bounds and pWorldGeometry were made for
+		uint32_t appliedTransformVersion{};
+		uint32_t appliedGeometryVersion{};
+		//Bumped every time UpdateTransforms recalculates, caches of the world transform or bounds compare against it
+		uint32_t worldVersion{};
+
+		void Translate(const Vector3& translation)
+		{
+			SetTransform(translationTransform, Matrix::CreateTranslation(translation));
+		}
+
+		void RotateY(float yaw)
+		{
+			SetTransform(rotationTransform, Matrix::CreateRotationY(yaw));
+		}
+
+		void Scale(const Vector3& scale)
+		{
+			SetTransform(scaleTransform, Matrix::CreateScale(scale));
+		}
+
+		void SetParentTransform(const Matrix& transform)
+		{
+			SetTransform(parentTransform, transform);
+		}
+
+		//World transform or bounds are out of date, UpdateTransforms would change something
+		bool IsDirty() const
+		{
+			// a rigid mesh shouldn't have a world space copy, any other mesh needs one
+			const bool hasExpectedGeometry{ isRigid != static_cast<bool>(pWorldGeometry) };
+
+			return appliedTransformVersion != transformVersion || appliedGeometryVersion != pGeometry->version ||
+				pGeometry->NeedsBVHBuild() || !hasExpectedGeometry;
+		}
+
+		//Appends to the shared geometry, every instance of it gets the triangle
+		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
+		{
+			pGeometry->AppendTriangle(triangle);
+
+			//Not ideal, but making sure all vertices are updated
+			if(!ignoreTransformUpdate)
+				UpdateTransforms();
+		}
+
+		//Does nothing for a mesh that isn't dirty, safe to call every frame
+		void UpdateTransforms()
+		{
+			if (!IsDirty())
+				return;
+
+			//Calculate Final Transform 
+			//const auto finalTransform = ...
+			const Matrix finalTransform{ scaleTransform * rotationTransform * translationTransform * parentTransform };
+
+			worldTransform = finalTransform;
+			inverseWorldTransform = Matrix::Inverse(finalTransform);
+			normalTransform = rotationTransform * parentTransform.GetRotation();
+
+			//First instance to get here builds the shared hierarchy
+			if (pGeometry->NeedsBVHBuild())
+				pGeometry->BuildBVH();
+
+			//The world copy has to take the triangles over again, not just move the vertices
+			const bool isNewGeometry{ appliedGeometryVersion != pGeometry->version };
+
+			appliedTransformVersion = transformVersion;
+			appliedGeometryVersion = pGeometry->version;
+			++worldVersion;
+
+			if (isRigid)
+			{
+				//Only the world bounds follow the transform
+				pWorldGeometry.reset();
+				UpdateTransformedAABB(finalTransform);
+				return;
+			}
+
+			UpdateWorldGeometry(finalTransform, isNewGeometry);
+		}
+
+		void SetTransform(Matrix& transform, const Matrix& newTransform)
+		{
+			//Animations set the same value every frame while paused, that shouldn't dirty anything
+			if (transform == newTransform)
+				return;
+
+			transform = newTransform;
+			++transformVersion;
+		}
+
+		void UpdateWorldGeometry(const Matrix& finalTransform, bool isNewGeometry)
+		{
+			const MeshGeometry& geometry{ *pGeometry };
+
+			if (!pWorldGeometry)
+			{
+				pWorldGeometry = std::make_shared<MeshGeometry>();
+				isNewGeometry = true;
+			}
+
+			//Triangles were appended or the geometry was swapped since the last copy
+			if (isNewGeometry)
+			{
+				if (geometry.isCompact)
+				{
+					//The world copy is always plain floats, compact geometry is decoded once per version and transformed from there
+					const CompactTriangles& compact{ geometry.compact };
+
+					decodedPositions.resize(compact.positions.size());
+					for (uint32_t vertex{}; vertex < decodedPositions.size(); ++vertex)
+						decodedPositions[vertex] = compact.GetPosition(vertex);
+
+					decodedNormals.resize(compact.normals.size());
+					for (int triangleIndex{}; triangleIndex < static_cast<int>(decodedNormals.size()); ++triangleIndex)
+						decodedNormals[triangleIndex] = compact.GetNormal(triangleIndex);
+
+					pWorldGeometry->indices.resize(static_cast<size_t>(geometry.GetTriangleCount()) * 3);
+					for (size_t index{}; index < pWorldGeometry->indices.size(); ++index)
+						pWorldGeometry->indices[index] = static_cast<int>(compact.GetIndex(index));
+				}
+				else
+				{
+					pWorldGeometry->indices = geometry.indices;
+				}
+			}
+
+			const std::vector<Vector3>& positions{ geometry.isCompact ? decodedPositions : geometry.positions };
+			const std::vector<Vector3>& normals{ geometry.isCompact ? decodedNormals : geometry.normals };
+
+			MeshGeometry& worldGeometry{ *pWorldGeometry };
+			worldGeometry.positions.resize(positions.size());
+			worldGeometry.normals.resize(normals.size());
+
+			//Transform Positions (positions > transformedPositions), the world bounds come out of the same pass
+			if (!positions.empty())
+			{
+				const AABB worldBounds{ TransformVertices<true>(finalTransform, positions, worldGeometry.positions) };
+				worldGeometry.minAABB = transformedMinAABB = worldBounds.minAABB;
+				worldGeometry.maxAABB = transformedMaxAABB = worldBounds.maxAABB;
+			}
+			else
+			{
+				UpdateTransformedAABB(finalTransform);
+			}
+
+			//Transform Normals (normals > transformedNormals)
+			TransformVertices<false>(normalTransform, normals, worldGeometry.normals);
+
+			//A changed triangle count makes the refit fail and the hierarchy gets built over again
+			worldGeometry.UpdateBVH(worldTriangleBounds);
+		}
+
+		/**
+		 * \brief Transforms source into destination as points or as directions, Vector3x8::Size vertices at a time.
+		 * Meshes of ParallelTransformThreshold vertices or more are split in chunks over the cores
+		 * \return Bounds of the transformed points, empty for directions
+		 */
+		template<bool IsPoint>
+		static AABB TransformVertices(const Matrix& transform, const std::vector<Vector3>& source, std::vector<Vector3>& destination)
+		{
+			const uint32_t vertexCount{ static_cast<uint32_t>(source.size()) };
+
+			const auto transformRange{
+				[&](uint32_t begin, uint32_t end)
+				{
+					using namespace SIMD;
+					using Lanes = FloatLanes;
+
+					// auto rather than spelling out Vector3Lanes<Lanes>, naming a class template on a vector register type
+					// makes GCC and Clang warn that its alignment attributes get dropped
+					auto minLanes{ Set3<Lanes>(FLT_MAX, FLT_MAX, FLT_MAX) };
+					auto maxLanes{ Set3<Lanes>(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+					Vector3x8 batch{};
+
+					for (uint32_t first{ begin }; first < end; first += Vector3x8::Size)
+					{
+						const uint32_t count{ std::min(end - first, Vector3x8::Size) };
+						batch.Load(&source[first], count);
+
+						// the lanes past the end repeat a vertex of this batch, they can't widen the bounds
+						for (uint32_t lane{ count }; lane < Vector3x8::Size; ++lane)
+							batch.Set(lane, source[first]);
+
+						for (uint32_t lane{}; lane < Vector3x8::Size; lane += LaneCount)
+						{
+							if constexpr (IsPoint)
+							{
+								const auto point{ transform.TransformPoint(batch.GetLanes<Lanes>(lane)) };
+								minLanes = { Min(minLanes.x, point.x), Min(minLanes.y, point.y), Min(minLanes.z, point.z) };
+								maxLanes = { Max(maxLanes.x, point.x), Max(maxLanes.y, point.y), Max(maxLanes.z, point.z) };
+								batch.SetLanes(lane, point);
+							}
+							else
+							{
+								batch.SetLanes(lane, transform.TransformVector(batch.GetLanes<Lanes>(lane)));
+							}
+						}
+
+						batch.Store(&destination[first], count);
+					}
+
+					// every lane kept its own bounds, merge them
+					Vector3x8 minPoints{};
+					Vector3x8 maxPoints{};
+					minPoints.SetLanes<Lanes>(0, minLanes);
+					maxPoints.SetLanes<Lanes>(0, maxLanes);
+
+					AABB bounds{};
+					for (uint32_t lane{}; lane < LaneCount; ++lane)
+					{
+						bounds.Grow(minPoints.Get(lane));
+						bounds.Grow(maxPoints.Get(lane));
+					}
+
+					return bounds;
+				} };
+
+			if (vertexCount < ParallelTransformThreshold)
+				return transformRange(0, vertexCount);
+
+			std::vector<AABB> chunkBounds((vertexCount + TransformChunkSize - 1) / TransformChunkSize);
+			std::for_each(std::execution::par, chunkBounds.begin(), chunkBounds.end(),
+				[&](AABB& bounds)
+				{
+					const uint32_t begin{ static_cast<uint32_t>(&bounds - chunkBounds.data()) * TransformChunkSize };
+					bounds = transformRange(begin, std::min(begin + TransformChunkSize, vertexCount));
+				});
+
+			AABB bounds{};
+			for (const AABB& chunk : chunkBounds)
+				bounds.Grow(chunk);
+
+			return bounds;
+		}
 
 		void UpdateTransformedAABB(const Matrix& finalTransform)
 		{
+			const Vector3& minAABB{ pGeometry->minAABB };
+			const Vector3& maxAABB{ pGeometry->maxAABB };
+
 			Vector3 tMinAABB{ finalTransform.TransformPoint(minAABB) };
 			Vector3 tMaxAABB{ tMinAABB };
 
@@ -215,8 +882,8 @@ namespace dae
 			tMinAABB = Vector3::Min(tAABB, tMinAABB);
 			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
 
-			// xMax / yMax / zMin
-			tAABB = finalTransform.TransformPoint(maxAABB.x, maxAABB.y, minAABB.z);
+			// xMin / yMax / zMin
+			tAABB = finalTransform.TransformPoint(minAABB.x, maxAABB.y, minAABB.z);
 			tMinAABB = Vector3::Min(tAABB, tMinAABB);
 			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
 
@@ -259,6 +926,50 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	//Square block of rays sharing one origin, directions are stored per component so four lanes load as one vector
+	struct alignas(16) RayPacket
+	{
+		static constexpr uint32_t Width{ 4 };
+		static constexpr uint32_t Size{ Width * Width };
+
+		// lane arrays come first so every one of them starts 16 byte aligned
+		// the SIMD tests load all lanes at once, lanes outside activeMask hold zero or an earlier ray and their results are masked off
+		float directionX[Size]{};
+		float directionY[Size]{};
+		float directionZ[Size]{};
+		float inverseDirectionX[Size]{};
+		float inverseDirectionY[Size]{};
+		float inverseDirectionZ[Size]{};
+		float max[Size]{};
+
+		Vector3 origin{};
+		float min{ 0.0001f };
+
+		// Directions through the corners of the area the packet covers, clockwise
+		// Every ray of the packet lies inside the frustum they span, packets without them (hasFrustum false) point anywhere
+		Vector3 cornerDirections[4]{};
+		bool hasFrustum{ false };
+
+		// Lanes that hold a ray, a bit per lane
+		uint32_t activeMask{};
+
+		Ray GetRay(uint32_t lane) const
+		{
+			return { origin, { directionX[lane], directionY[lane], directionZ[lane] }, min, max[lane] };
+		}
+
+		void SetRay(uint32_t lane, const Vector3& direction, float rayMax = FLT_MAX)
+		{
+			directionX[lane] = direction.x;
+			directionY[lane] = direction.y;
+			directionZ[lane] = direction.z;
+			inverseDirectionX[lane] = 1.f / direction.x;
+			inverseDirectionY[lane] = 1.f / direction.y;
+			inverseDirectionZ[lane] = 1.f / direction.z;
+			max[lane] = rayMax;
+		}
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -0,0 +1,222 @@
+#include "LightBVH.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	void LightBVH::Build(const std::vector<Light>& lights)
+	{
+		Clear();
+
+		for (uint32_t lightIndex{}; lightIndex < lights.size(); ++lightIndex)
+		{
+			const Light& light{ lights[lightIndex] };
+
+			if (light.type == LightType::Directional)
+			{
+				m_DirectionalLights.push_back(lightIndex);
+				continue;
+			}
+
+			m_LightIndices.push_back(lightIndex);
+		}
+
+		const uint32_t nrLights{ static_cast<uint32_t>(m_LightIndices.size()) };
+		if (nrLights == 0)
+			return;
+
+		// indexed by light while building, reordered to follow the leaves afterwards
+		m_Positions.resize(lights.size());
+		m_Powers.resize(lights.size());
+		for (const uint32_t lightIndex : m_LightIndices)
+		{
+			m_Positions[lightIndex] = lights[lightIndex].origin;
+			m_Powers[lightIndex] = lights[lightIndex].color.MaxComponent() * lights[lightIndex].intensity;
+		}
+
+		// A binary tree never needs more than 2N - 1 nodes
+		m_Nodes.reserve(2 * size_t(nrLights) - 1);
+
+		LightBVHNode& root{ m_Nodes.emplace_back() };
+		root.leftFirst = 0;
+		root.lightCount = nrLights;
+
+		UpdateNode(0);
+		Subdivide(0, 1);
+
+		std::vector<Vector3> positions(nrLights);
+		std::vector<float> powers(nrLights);
+		for (uint32_t index{}; index < nrLights; ++index)
+		{
+			positions[index] = m_Positions[m_LightIndices[index]];
+			powers[index] = m_Powers[m_LightIndices[index]];
+		}
+
+		m_Positions.swap(positions);
+		m_Powers.swap(powers);
+	}
+
+	void LightBVH::Clear()
+	{
+		// clear keeps the capacity around, rebuilding every frame won't reallocate
+		m_Nodes.clear();
+		m_LightIndices.clear();
+		m_Positions.clear();
+		m_Powers.clear();
+		m_DirectionalLights.clear();
+	}
+
+	bool LightBVH::SampleLight(const Vector3& point, const Vector3& normal, float random, uint32_t& lightIndex, float& probability) const
+	{
+		if (m_Nodes.empty())
+			return false;
+
+		probability = 1.f;
+		const LightBVHNode* pNode{ &m_Nodes[0] };
+
+		// walk down picking a child by importance, the random number is stretched back to [0, 1) after every pick
+		while (!pNode->IsLeaf())
+		{
+			const LightBVHNode& left{ m_Nodes[pNode->leftFirst] };
+			const LightBVHNode& right{ m_Nodes[pNode->leftFirst + 1] };
+
+			const float leftImportance{ GetImportance(left, point, normal) };
+			const float totalImportance{ leftImportance + GetImportance(right, point, normal) };
+			if (totalImportance <= 0.f)
+				return false;
+
+			const float leftProbability{ leftImportance / totalImportance };
+			if (random < leftProbability)
+			{
+				random /= leftProbability;
+				probability *= leftProbability;
+				pNode = &left;
+			}
+			else
+			{
+				random = (random - leftProbability) / (1.f - leftProbability);
+				probability *= 1.f - leftProbability;
+				pNode = &right;
+			}
+		}
+
+		// the lights of a leaf are few enough to weigh one by one, facing included
+		float importances[MaxLeafSize]{};
+		float totalImportance{};
+
+		const uint32_t lightCount{ std::min(pNode->lightCount, MaxLeafSize) };
+		for (uint32_t index{}; index < lightCount; ++index)
+		{
+			const Vector3 toLight{ m_Positions[pNode->leftFirst + index] - point };
+			const float sqrDistance{ std::max(toLight.SqrMagnitude(), FLT_EPSILON) };
+			const float cosine{ Vector3::Dot(toLight, normal) / sqrtf(sqrDistance) };
+
+			importances[index] = cosine > 0.f ? m_Powers[pNode->leftFirst + index] * cosine / sqrDistance : 0.f;
+			totalImportance += importances[index];
+		}
+
+		if (totalImportance <= 0.f)
+			return false;
+
+		float target{ std::min(random, 1.f) * totalImportance };
+		uint32_t pick{};
+		while (pick + 1 < lightCount && (target >= importances[pick] || importances[pick] <= 0.f))
+		{
+			target -= importances[pick];
+			++pick;
+		}
+
+		lightIndex = m_LightIndices[pNode->leftFirst + pick];
+		probability *= importances[pick] / totalImportance;
+		return probability > 0.f;
+	}
+
+	void LightBVH::Subdivide(uint32_t nodeIndex, uint32_t depth)
+	{
+		// Copy, the node reference would dangle once children are pushed
+		const LightBVHNode node{ m_Nodes[nodeIndex] };
+
+		// median splits halve the node every level, MaxDepth is never what stops them
+		if (node.lightCount <= MaxLeafSize || depth >= MaxDepth)
+			return;
+
+		// lights are points, the node bounds are the centroid bounds
+		const Vector3 extent{ node.bounds.maxAABB - node.bounds.minAABB };
+		int axis{ extent.x > extent.y ? 0 : 1 };
+		if (extent.z > extent[axis])
+			axis = 2;
+
+		// median split along the longest axis, keeps the tree balanced no matter how the lights are clustered
+		const uint32_t leftCount{ node.lightCount / 2 };
+		const auto first{ m_LightIndices.begin() + node.leftFirst };
+		std::nth_element(first, first + leftCount, first + node.lightCount, [&](uint32_t a, uint32_t b)
+			{
+				return m_Positions[a][axis] < m_Positions[b][axis];
+			});
+
+		const uint32_t leftIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+		m_Nodes.emplace_back(LightBVHNode{ {}, 0.f, 0.f, node.leftFirst, leftCount });
+		m_Nodes.emplace_back(LightBVHNode{ {}, 0.f, 0.f, node.leftFirst + leftCount, node.lightCount - leftCount });
+
+		m_Nodes[nodeIndex].leftFirst = leftIndex;
+		m_Nodes[nodeIndex].lightCount = 0;
+
+		UpdateNode(leftIndex);
+		UpdateNode(leftIndex + 1);
+
+		Subdivide(leftIndex, depth + 1);
+		Subdivide(leftIndex + 1, depth + 1);
+	}
+
+	void LightBVH::UpdateNode(uint32_t nodeIndex)
+	{
+		LightBVHNode& node{ m_Nodes[nodeIndex] };
+		node.bounds = {};
+		node.maxPower = 0.f;
+		node.totalPower = 0.f;
+
+		for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.lightCount; ++index)
+		{
+			const uint32_t lightIndex{ m_LightIndices[index] };
+
+			node.bounds.Grow(m_Positions[lightIndex]);
+			node.maxPower = std::max(node.maxPower, m_Powers[lightIndex]);
+			node.totalPower += m_Powers[lightIndex];
+		}
+	}
+
+	float LightBVH::GetImportance(const LightBVHNode& node, const Vector3& point, const Vector3& normal) const
+	{
+		if (IsBehind(node.bounds, point, normal))
+			return 0.f;
+
+		// inside or close to the node every light could be the nearest one, don't let the distance blow up
+		const Vector3 halfExtent{ (node.bounds.maxAABB - node.bounds.minAABB) * 0.5f };
+		const float sqrDistance{ std::max((node.bounds.Center() - point).SqrMagnitude(), halfExtent.SqrMagnitude()) };
+
+		return node.totalPower / std::max(sqrDistance, FLT_EPSILON);
+	}
+
+	bool LightBVH::IsBehind(const AABB& bounds, const Vector3& point, const Vector3& normal)
+	{
+		// the corner furthest along the normal is still below the surface
+		const Vector3 halfExtent{ (bounds.maxAABB - bounds.minAABB) * 0.5f };
+		const float reach{ halfExtent.x * fabsf(normal.x) + halfExtent.y * fabsf(normal.y) + halfExtent.z * fabsf(normal.z) };
+
+		return Vector3::Dot(bounds.Center() - point, normal) + reach < 0.f;
+	}
+
+	float LightBVH::SqrDistance(const AABB& bounds, const Vector3& point)
+	{
+		const Vector3 closest{ Vector3::Max(bounds.minAABB, Vector3::Min(point, bounds.maxAABB)) };
+		return (closest - point).SqrMagnitude();
+	}
+
+	float LightBVH::SqrDistance(const AABB& bounds, const AABB& other)
+	{
+		// gap between the boxes along every axis, zero where they overlap
+		const Vector3 gap{ Vector3::Max(Vector3::Max(bounds.minAABB - other.maxAABB, other.minAABB - bounds.maxAABB), Vector3{}) };
+		return gap.SqrMagnitude();
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "BVH.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct LightBVHNode
+	{
+		AABB bounds{};
+
+		// Brightest channel of color * intensity, of the brightest light below the node and summed over all of them
+		float maxPower{};
+		float totalPower{};
+
+		// Leaf: index of the first light in the light index list
+		// Inner node: index of the left child, the right child is stored right after it
+		uint32_t leftFirst{};
+		uint32_t lightCount{};
+
+		bool IsLeaf() const { return lightCount > 0; }
+	};
+
+	/**
+	 * \brief Bounding volume hierarchy over the point lights of a scene.
+	 * Every node knows the bounds and the power of the lights below it, so whole groups of lights
+	 * can be skipped when they are too far away or behind a surface. Directional lights have no position,
+	 * they are kept aside and visited for every shading point
+	 */
+	class LightBVH final
+	{
+	public:
+		static constexpr uint32_t MaxDepth{ 64 };
+		static constexpr uint32_t MaxLeafSize{ 4 };
+
+		void Build(const std::vector<Light>& lights);
+		void Clear();
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		uint32_t GetLightCount() const { return static_cast<uint32_t>(m_LightIndices.size()); }
+		const std::vector<LightBVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<uint32_t>& GetDirectionalLights() const { return m_DirectionalLights; }
+
+		//Calls visit(lightIndex) for every point light in front of the surface at point that can reach a radiance of at least threshold there
+		template<typename Visit>
+		void ForEachLight(const Vector3& point, const Vector3& normal, float threshold, Visit&& visit) const;
+		//Same for a whole region, every point light whose influence radius sqrt(power / threshold) reaches into bounds
+		template<typename Visit>
+		void ForEachLight(const AABB& bounds, float threshold, Visit&& visit) const;
+
+		/**
+		 * \brief Picks one point light with a probability proportional to an estimate of what it adds at point,
+		 * random is a uniform number in [0, 1)
+		 * \return false when no light can reach the point
+		 */
+		bool SampleLight(const Vector3& point, const Vector3& normal, float random, uint32_t& lightIndex, float& probability) const;
+
+	private:
+		void Subdivide(uint32_t nodeIndex, uint32_t depth);
+		void UpdateNode(uint32_t nodeIndex);
+
+		float GetImportance(const LightBVHNode& node, const Vector3& point, const Vector3& normal) const;
+
+		static bool IsBehind(const AABB& bounds, const Vector3& point, const Vector3& normal);
+		static float SqrDistance(const AABB& bounds, const Vector3& point);
+		static float SqrDistance(const AABB& bounds, const AABB& other);
+
+		std::vector<LightBVHNode> m_Nodes{};
+		std::vector<uint32_t> m_LightIndices{};
+		std::vector<Vector3> m_Positions{};
+		std::vector<float> m_Powers{};
+		std::vector<uint32_t> m_DirectionalLights{};
+	};
+
+	template<typename Visit>
+	void LightBVH::ForEachLight(const Vector3& point, const Vector3& normal, float threshold, Visit&& visit) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		uint32_t stack[MaxDepth + 1];
+		uint32_t stackSize{};
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const LightBVHNode& node{ m_Nodes[stack[--stackSize]] };
+
+			// even the brightest light below can't get past the threshold from the closest corner
+			if (IsBehind(node.bounds, point, normal) || node.maxPower < threshold * SqrDistance(node.bounds, point))
+				continue;
+
+			if (!node.IsLeaf())
+			{
+				stack[stackSize++] = node.leftFirst + 1;
+				stack[stackSize++] = node.leftFirst;
+				continue;
+			}
+
+			for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.lightCount; ++index)
+			{
+				if (m_Powers[index] >= threshold * (m_Positions[index] - point).SqrMagnitude())
+					visit(m_LightIndices[index]);
+			}
+		}
+	}
+
+	template<typename Visit>
+	void LightBVH::ForEachLight(const AABB& bounds, float threshold, Visit&& visit) const
+	{
+		if (m_Nodes.empty())
+			return;
+
+		uint32_t stack[MaxDepth + 1];
+		uint32_t stackSize{};
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const LightBVHNode& node{ m_Nodes[stack[--stackSize]] };
+
+			if (node.maxPower < threshold * SqrDistance(node.bounds, bounds))
+				continue;
+
+			if (!node.IsLeaf())
+			{
+				stack[stackSize++] = node.leftFirst + 1;
+				stack[stackSize++] = node.leftFirst;
+				continue;
+			}
+
+			for (uint32_t index{ node.leftFirst }; index < node.leftFirst + node.lightCount; ++index)
+			{
+				if (m_Powers[index] >= threshold * SqrDistance(bounds, m_Positions[index]))
+					visit(m_LightIndices[index]);
+			}
+		}
+	}
+}
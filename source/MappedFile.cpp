@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+//Platform includes
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	const HANDLE file{ CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_Size = static_cast<size_t>(size.QuadPart);
+	m_IsOpen = true;
+
+	// a mapping of zero bytes can't be created, empty files just have no view
+	if (m_Size == 0)
+		return true;
+
+	m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_MappingHandle)
+		m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+	const int file{ open(filename.c_str(), O_RDONLY) };
+	if (file < 0)
+		return false;
+
+	struct stat status {};
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	m_Size = static_cast<size_t>(status.st_size);
+	m_IsOpen = true;
+
+	if (m_Size > 0)
+	{
+		void* pView{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0) };
+		if (pView != MAP_FAILED)
+		{
+			// parsers run through it front to back
+			madvise(pView, m_Size, MADV_SEQUENTIAL);
+			m_pData = static_cast<const char*>(pView);
+		}
+	}
+
+	// the mapping keeps its own reference to the file
+	close(file);
+#endif
+
+	if (m_Size > 0 && !m_pData)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle)
+		CloseHandle(m_FileHandle);
+
+	m_MappingHandle = nullptr;
+	m_FileHandle = nullptr;
+#else
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+#endif
+
+	m_pData = nullptr;
+	m_Size = 0;
+	m_IsOpen = false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+//Standard includes
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	/**
+	 * \brief Read-only view of a whole file mapped into memory, pages are only read from disk once they are touched.
+	 * The view stays valid until the MappedFile is closed or destroyed
+	 */
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//Closes whatever was open first, an empty file opens fine with a null view
+		bool Open(const std::string& filename);
+		void Close();
+
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{ nullptr };
+		size_t m_Size{};
+		bool m_IsOpen{ false };
+
+#ifdef _WIN32
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+#endif
+	};
+}
@@ -2,47 +2,74 @@
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
+#include "SIMD.h"
+
+#include <algorithm>
+#include <variant>
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+#pragma region Shading Batch
+	/**
+	 * \brief Directions towards up to Size lights seen from one hit point, and the BRDF towards each of them after shading.
+	 * Stored a component per array so materials can evaluate SIMD::LaneCount lights with every instruction,
+	 * they always shade all Size lanes and leave it to the caller to ignore the ones it didn't fill
+	 */
+	struct ShadingBatch
 	{
-	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
-
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		static constexpr uint32_t Size{ Vector3x8::Size };
+
+		Vector3x8 lights{};
+
+		alignas(32) float r[Size]{};
+		alignas(32) float g[Size]{};
+		alignas(32) float b[Size]{};
+
+		ColorRGB GetColor(uint32_t lane) const { return { r[lane], g[lane], b[lane] }; }
+
+		void Fill(const ColorRGB& color)
+		{
+			std::fill_n(r, Size, color.r);
+			std::fill_n(g, Size, color.g);
+			std::fill_n(b, Size, color.b);
+		}
+
+		template<typename Lanes>
+		void StoreColors(uint32_t firstLane, const SIMD::ColorRGBLanes<Lanes>& colors)
+		{
+			SIMD::Store(r + firstLane, colors.r);
+			SIMD::Store(g + firstLane, colors.g);
+			SIMD::Store(b + firstLane, colors.b);
+		}
 	};
 #pragma endregion
 
 #pragma region Material SOLID COLOR
 	//SOLID COLOR
 	//===========
-	class Material_SolidColor final : public Material
+	class Material_SolidColor final
 	{
 	public:
 		Material_SolidColor(const ColorRGB& color): m_Color(color)
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
 			return m_Color;
 		}
 
+		void Shade(const HitRecord&, const Vector3&, ShadingBatch& batch) const
+		{
+			batch.Fill(m_Color);
+		}
+
+		//Largest channel Shade times the cosine of the light angle can reach, over every light and view direction
+		float GetMaxReflectance() const
+		{
+			return m_Color.MaxComponent();
+		}
+
 	private:
 		ColorRGB m_Color{colors::White};
 	};
@@ -51,18 +78,28 @@ namespace dae
 #pragma region Material LAMBERT
 	//LAMBERT
 	//=======
-	class Material_Lambert final : public Material
+	class Material_Lambert final
 	{
 	public:
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance){}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			//todo: W3
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
+		void Shade(const HitRecord&, const Vector3&, ShadingBatch& batch) const
+		{
+			batch.Fill(BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor));
+		}
+
+		float GetMaxReflectance() const
+		{
+			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor).MaxComponent();
+		}
+
 	private:
 		ColorRGB m_DiffuseColor{colors::White};
 		float m_DiffuseReflectance{1.f}; //kd
@@ -72,7 +109,7 @@ namespace dae
 #pragma region Material LAMBERT PHONG
 	//LAMBERT-PHONG
 	//=============
-	class Material_LambertPhong final : public Material
+	class Material_LambertPhong final
 	{
 	public:
 		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent):
@@ -81,13 +118,39 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			//todo: W3
 			return	BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) +
 					BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
 		}
 
+		//Shade for every light direction in the batch, v is the same for all of them
+		void Shade(const HitRecord& hitRecord, const Vector3& v, ShadingBatch& batch) const
+		{
+			using Lanes = SIMD::FloatLanes;
+
+			const ColorRGB diffuse{ BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) };
+			const SIMD::Vector3Lanes<Lanes> n{ SIMD::Set3<Lanes>(hitRecord.normal.x, hitRecord.normal.y, hitRecord.normal.z) };
+			const SIMD::Vector3Lanes<Lanes> reflectedView{ SIMD::Set3<Lanes>(-v.x, -v.y, -v.z) };
+
+			for (uint32_t lane{}; lane < ShadingBatch::Size; lane += SIMD::LaneCount)
+			{
+				const Lanes specular{ BRDF::Phong(m_SpecularReflectance, m_PhongExponent, batch.lights.GetLanes<Lanes>(lane), reflectedView, n) };
+
+				batch.StoreColors<Lanes>(lane, {
+					SIMD::Add(SIMD::Set1<Lanes>(diffuse.r), specular),
+					SIMD::Add(SIMD::Set1<Lanes>(diffuse.g), specular),
+					SIMD::Add(SIMD::Set1<Lanes>(diffuse.b), specular) });
+			}
+		}
+
+		float GetMaxReflectance() const
+		{
+			// the specular lobe isn't normalized, it peaks at ks
+			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor).MaxComponent() + m_SpecularReflectance;
+		}
+
 	private:
 		ColorRGB m_DiffuseColor{colors::White};
 		float m_DiffuseReflectance{0.5f}; //kd
@@ -98,7 +161,7 @@ namespace dae
 
 #pragma region Material COOK TORRENCE
 	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
+	class Material_CookTorrence final
 	{
 	public:
 		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness):
@@ -108,7 +171,7 @@ namespace dae
 			m_F0 = (m_Metalness < FLT_EPSILON) ? dielectric : m_Albedo;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			//todo: W3
 			const Vector3 halfVector{ ((v + l) * 0.5f).Normalized() };
@@ -126,6 +189,60 @@ namespace dae
 			return diffuse + specular;
 		}
 
+		//Shade for every light direction in the batch, v is the same for all of them
+		void Shade(const HitRecord& hitRecord, const Vector3& v, ShadingBatch& batch) const
+		{
+			using namespace SIMD;
+			using Lanes = FloatLanes;
+
+			const Vector3Lanes<Lanes> n{ Set3<Lanes>(hitRecord.normal.x, hitRecord.normal.y, hitRecord.normal.z) };
+			const Vector3Lanes<Lanes> view{ Set3<Lanes>(v.x, v.y, v.z) };
+			const Lanes viewCosine{ Dot(view, n) };
+
+			const bool isDielectric{ m_Metalness < FLT_EPSILON };
+			const Lanes one{ Set1<Lanes>(1.f) };
+
+			for (uint32_t lane{}; lane < ShadingBatch::Size; lane += LaneCount)
+			{
+				const Vector3Lanes<Lanes> l{ batch.lights.GetLanes<Lanes>(lane) };
+				const Vector3Lanes<Lanes> halfVector{ Normalized(Mul(Add(view, l), Set1<Lanes>(0.5f))) };
+
+				const ColorRGBLanes<Lanes> fresnel{ BRDF::FresnelFunction_Schlick(halfVector, view, m_F0) };
+				const Lanes normalDistribution{ BRDF::NormalDistribution_GGX(n, halfVector, m_Roughness) };
+				const Lanes geometry{ BRDF::GeometryFunction_Smith(n, view, l, m_Roughness) };
+
+				const Lanes scale{ Div(Mul(normalDistribution, geometry), Mul(Set1<Lanes>(4.f), Mul(viewCosine, Dot(l, n)))) };
+				const ColorRGBLanes<Lanes> specular{ Mul(fresnel.r, scale), Mul(fresnel.g, scale), Mul(fresnel.b, scale) };
+
+				if (!isDielectric)
+				{
+					batch.StoreColors<Lanes>(lane, specular);
+					continue;
+				}
+
+				// Lambert with kd = White - specular
+				batch.StoreColors<Lanes>(lane, {
+					Add(Mul(Sub(one, specular.r), Set1<Lanes>(m_Albedo.r / PI)), specular.r),
+					Add(Mul(Sub(one, specular.g), Set1<Lanes>(m_Albedo.g / PI)), specular.g),
+					Add(Mul(Sub(one, specular.b), Set1<Lanes>(m_Albedo.b / PI)), specular.b) });
+			}
+		}
+
+		float GetMaxReflectance() const
+		{
+			// D peaks at 1 / (PI * alpha^2), G(v) / (n.v) at 1 / k and G(l) and the fresnel term at 1,
+			// the cosine of the light angle cancels the one in the denominator
+			const float alphaSqr{ m_Roughness * m_Roughness * m_Roughness * m_Roughness };
+			if (alphaSqr <= 0.f)
+				return FLT_MAX;
+
+			const float a{ m_Roughness * m_Roughness + 1 };
+			const float k{ a * a * 0.125f };
+			const float specular{ 1.f / (4 * PI * alphaSqr * k) };
+
+			return (m_Metalness < FLT_EPSILON) ? m_Albedo.MaxComponent() / PI + specular : specular;
+		}
+
 	private:
 		ColorRGB m_Albedo{0.955f, 0.637f, 0.538f}; //Copper
 		ColorRGB m_F0{};
@@ -133,4 +250,31 @@ namespace dae
 		float m_Roughness{0.1f}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
 #pragma endregion
+
+#pragma region Material
+	/**
+	 * \brief Every material type the scene can hold, stored by value so a scene keeps its materials in one contiguous block.
+	 * Shading goes through std::visit, the renderer visits once per hit point and gets the BRDF of that type inlined in its light loop
+	 */
+	using Material = std::variant<Material_SolidColor, Material_Lambert, Material_LambertPhong, Material_CookTorrence>;
+
+	/**
+	 * \brief Function used to calculate the correct color for the specific material and its parameters
+	 * \param material material of the hit
+	 * \param hitRecord current hitrecord
+	 * \param l light direction
+	 * \param v view direction
+	 * \return color
+	 */
+	inline ColorRGB Shade(const Material& material, const HitRecord& hitRecord, const Vector3& l, const Vector3& v)
+	{
+		return std::visit([&](const auto& typedMaterial) { return typedMaterial.Shade(hitRecord, l, v); }, material);
+	}
+
+	//Bound on what a light of radiance 1 can add to the color of a hit with this material, see the GetMaxReflectance of every type
+	inline float GetMaxReflectance(const Material& material)
+	{
+		return std::visit([](const auto& typedMaterial) { return typedMaterial.GetMaxReflectance(); }, material);
+	}
+#pragma endregion
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "Vector3.h"
 #include "Vector4.h"
+#include "Vector3x8.h"
 #include "Matrix.h"
 #include "ColorRGB.h"
 #include "MathHelpers.h"
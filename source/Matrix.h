@@ -1,53 +1,318 @@
 #pragma once
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <type_traits>
+
+#include "SIMD.h"
 #include "Vector3.h"
+#include "Vector3x8.h"
 #include "Vector4.h"
 
 namespace dae {
+	/**
+	 * \brief Row-major affine transform, points and vectors are rows multiplied from the left.
+	 * Defined inline like Vector3, the transforms combine rows with SSE when it isn't evaluated at compile time
+	 */
 	struct Matrix
 	{
-		Matrix() = default;
-		Matrix(
+		constexpr Matrix() = default;
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-		const Matrix& Transpose();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+			const Vector4& t) :
+			data{ xAxis, yAxis, zAxis, t }
+		{
+		}
+
+		constexpr Matrix(const Matrix& m) = default;
+		constexpr Matrix& operator=(const Matrix& m) = default;
+
+		constexpr Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v[0], v[1], v[2]);
+		}
+
+		constexpr Vector3 TransformVector(float x, float y, float z) const
+		{
+#ifdef SIMD_SSE
+			if (!std::is_constant_evaluated())
+				return TransformRow(x, y, z, _mm_setzero_ps());
+#endif
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z,
+				data[0].y * x + data[1].y * y + data[2].y * z,
+				data[0].z * x + data[1].z * y + data[2].z * z
+			};
+		}
+
+		constexpr Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p[0], p[1], p[2]);
+		}
+
+		constexpr Vector3 TransformPoint(float x, float y, float z) const
+		{
+#ifdef SIMD_SSE
+			if (!std::is_constant_evaluated())
+				return TransformRow(x, y, z, data[3].Load());
+#endif
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			};
+		}
+
+		//TransformPoint for a lane per point
+		template<typename Lanes>
+		SIMD::Vector3Lanes<Lanes> TransformPoint(const SIMD::Vector3Lanes<Lanes>& p) const
+		{
+			using namespace SIMD;
+			return Add(TransformVector(p), Set3<Lanes>(data[3].x, data[3].y, data[3].z));
+		}
+
+		//TransformVector for a lane per vector
+		template<typename Lanes>
+		SIMD::Vector3Lanes<Lanes> TransformVector(const SIMD::Vector3Lanes<Lanes>& v) const
+		{
+			using namespace SIMD;
+			Vector3Lanes<Lanes> result{ Mul(Set3<Lanes>(data[0].x, data[0].y, data[0].z), v.x) };
+			result = Add(result, Mul(Set3<Lanes>(data[1].x, data[1].y, data[1].z), v.y));
+			return Add(result, Mul(Set3<Lanes>(data[2].x, data[2].y, data[2].z), v.z));
+		}
+
+		//TransformPoint for all eight points at once
+		void TransformPoints(Vector3x8& points) const
+		{
+			for (uint32_t lane{}; lane < Vector3x8::Size; lane += SIMD::LaneCount)
+				points.SetLanes(lane, TransformPoint(points.GetLanes<SIMD::FloatLanes>(lane)));
+		}
+
+		//TransformVector for all eight vectors at once
+		void TransformVectors(Vector3x8& vectors) const
+		{
+			for (uint32_t lane{}; lane < Vector3x8::Size; lane += SIMD::LaneCount)
+				vectors.SetLanes(lane, TransformVector(vectors.GetLanes<SIMD::FloatLanes>(lane)));
+		}
+
+		constexpr const Matrix& Transpose()
+		{
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result[r][c] = data[c][r];
+				}
+			}
+
+			*this = result;
+			return *this;
+		}
+
+		constexpr const Matrix& Inverse()
+		{
+			//Affine inverse, the last column has to be (0, 0, 0, 1)
+			assert(data[0].w == 0 && data[1].w == 0 && data[2].w == 0 && data[3].w == 1);
+
+			const Vector3 xAxis{ data[0] };
+			const Vector3 yAxis{ data[1] };
+			const Vector3 zAxis{ data[2] };
+			const Vector3 translation{ data[3] };
+
+			//Rows of the inverse 3x3 are the cross products of the columns divided by the determinant
+			const Vector3 yzCross{ Vector3::Cross(yAxis, zAxis) };
+			const Vector3 zxCross{ Vector3::Cross(zAxis, xAxis) };
+			const Vector3 xyCross{ Vector3::Cross(xAxis, yAxis) };
+
+			const float determinant{ Vector3::Dot(xAxis, yzCross) };
+			assert(determinant > FLT_EPSILON || determinant < -FLT_EPSILON);
+			const float invDeterminant{ 1.f / determinant };
+
+			data[0] = { yzCross.x * invDeterminant, zxCross.x * invDeterminant, xyCross.x * invDeterminant, 0 };
+			data[1] = { yzCross.y * invDeterminant, zxCross.y * invDeterminant, xyCross.y * invDeterminant, 0 };
+			data[2] = { yzCross.z * invDeterminant, zxCross.z * invDeterminant, xyCross.z * invDeterminant, 0 };
+			data[3] = { -TransformVector(translation), 1 };
+
+			return *this;
+		}
+
+		constexpr Vector3 GetAxisX() const { return data[0]; }
+		constexpr Vector3 GetAxisY() const { return data[1]; }
+		constexpr Vector3 GetAxisZ() const { return data[2]; }
+		constexpr Vector3 GetTranslation() const { return data[3]; }
+
+		//Axes scaled back to unit length and no translation, what normals and directions go through when there is no shear
+		Matrix GetRotation() const
+		{
+			return { GetAxisX().Normalized(), GetAxisY().Normalized(), GetAxisZ().Normalized(), Vector3::Zero };
+		}
+
+		static constexpr Matrix CreateTranslation(float x, float y, float z)
+		{
+			return {
+				{Vector3::UnitX, 0},
+				{Vector3::UnitY ,0},
+				{Vector3::UnitZ, 0},
+				{x, y, z, 1}
+			};
+		}
+
+		static constexpr Matrix CreateTranslation(const Vector3& t)
+		{
+			return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			return {
+				{Vector3::UnitX, 0},
+				{0, cosf(pitch), sinf(pitch), 0},
+				{0, -sinf(pitch), cosf(pitch) , 0},
+				{0,0,0,1}
+			};
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			return {
+				{cosf(yaw), 0,  -sinf(yaw), 0},
+				{Vector3::UnitY, 0},
+				{sinf(yaw), 0, cosf(yaw), 0 },
+				{0,0,0,1}
+			};
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			return {
+				{cosf(roll), sinf(roll), 0, 0},
+				{-sinf(roll), cosf(roll), 0, 0 },
+				{Vector3::UnitZ, 0},
+				{0,0,0,1}
+			};
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			return CreateRotationX(r.x) * CreateRotationY(r.y) * CreateRotationZ(r.z);
+		}
+
+		static constexpr Matrix CreateScale(float sx, float sy, float sz)
+		{
+			return {
+				{sx, 0, 0 ,0},
+				{0, sy, 0, 0},
+				{0, 0, sz, 0},
+				{0,0,0, 1}
+			};
+		}
+
+		static constexpr Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s[0], s[1], s[2]);
+		}
+
+		static constexpr Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+		static constexpr Matrix Inverse(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Inverse();
+
+			return out;
+		}
+
+		constexpr Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Vector4 operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr bool operator==(const Matrix& m) const = default;
+
+		constexpr Matrix operator*(const Matrix& m) const
+		{
+			Matrix result{ *this };
+			result *= m;
+			return result;
+		}
+
+		constexpr const Matrix& operator*=(const Matrix& m)
+		{
+#ifdef SIMD_SSE
+			if (!std::is_constant_evaluated())
+			{
+				// every row of the result is a row of this matrix transforming the rows of m, m can be this matrix
+				const __m128 rows[4]{ m.data[0].Load(), m.data[1].Load(), m.data[2].Load(), m.data[3].Load() };
+				for (Vector4& row : data)
+				{
+					__m128 result{ _mm_mul_ps(_mm_set1_ps(row.x), rows[0]) };
+					result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(row.y), rows[1]));
+					result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(row.z), rows[2]));
+					result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(row.w), rows[3]));
+					row.Store(result);
+				}
+				return *this;
+			}
+#endif
+			const Matrix copy{ *this };
+			const Matrix m_transposed{ Transpose(m) };
+
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					data[r][c] = Vector4::Dot(copy[r], m_transposed[c]);
+				}
+			}
+
+			return *this;
+		}
 
 	private:
+#ifdef SIMD_SSE
+		//x * xAxis + y * yAxis + z * zAxis + last, in the same order as the scalar version
+		Vector3 TransformRow(float x, float y, float z, __m128 last) const
+		{
+			__m128 result{ _mm_mul_ps(_mm_set1_ps(x), data[0].Load()) };
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(y), data[1].Load()));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(z), data[2].Load()));
+			result = _mm_add_ps(result, last);
+
+			Vector4 row;
+			row.Store(result);
+			return row;
+		}
+#endif
 
 		//Row-Major Matrix
 		Vector4 data[4]
@@ -63,4 +328,4 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
-}
\ No newline at end of file
+}
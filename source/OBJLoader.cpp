@@ -0,0 +1,688 @@
+#include "OBJLoader.h"
+
+//Standard includes
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+
+#include "MappedFile.h"
+
+using namespace dae;
+
+namespace
+{
+	bool IsSpace(char character)
+	{
+		return character == ' ' || character == '\t';
+	}
+
+	const char* SkipSpaces(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	// the line break itself, or pEnd for a last line without one
+	const char* FindLineEnd(const char* p, const char* pEnd)
+	{
+		const void* pBreak{ std::memchr(p, '\n', pEnd - p) };
+		return pBreak ? static_cast<const char*>(pBreak) : pEnd;
+	}
+
+	// nothing but whitespace, a carriage return or a comment left on the line
+	bool IsLineDone(const char* p, const char* pLineEnd)
+	{
+		p = SkipSpaces(p, pLineEnd);
+		return p == pLineEnd || *p == '\r' || *p == '#';
+	}
+
+	// a line starting with command followed by whitespace or nothing at all
+	bool IsCommand(const char* p, const char* pLineEnd, std::string_view command)
+	{
+		const size_t length{ command.size() };
+		return static_cast<size_t>(pLineEnd - p) >= length && std::string_view{ p, length } == command &&
+			(p + length == pLineEnd || IsSpace(p[length]) || p[length] == '\r');
+	}
+
+	bool ParseFloat(const char*& p, const char* pLineEnd, float& value)
+	{
+		p = SkipSpaces(p, pLineEnd);
+		if (p < pLineEnd && *p == '+')
+			++p;
+
+		const auto [pNext, error] { std::from_chars(p, pLineEnd, value) };
+		p = pNext;
+		return error == std::errc{};
+	}
+
+	// zero based index of a one based or negative face index, negative ones count back from count
+	bool ParseIndex(const char*& p, const char* pLineEnd, size_t count, int& index, bool& isRelative)
+	{
+		int value{};
+		const auto [pNext, error] { std::from_chars(p, pLineEnd, value) };
+		p = pNext;
+
+		isRelative = value < 0;
+		index = isRelative ? static_cast<int>(count) + value : value - 1;
+		return error == std::errc{} && value != 0;
+	}
+
+	// the rest of the line without the whitespace around it, a name can have spaces in it
+	std::string ParseName(const char* p, const char* pLineEnd)
+	{
+		p = SkipSpaces(p, pLineEnd);
+		while (pLineEnd > p && (IsSpace(pLineEnd[-1]) || pLineEnd[-1] == '\r'))
+			--pLineEnd;
+		return std::string(p, pLineEnd);
+	}
+
+	template<typename T>
+	void Append(std::vector<T>& destination, std::vector<T>&& source)
+	{
+		if (destination.empty())
+			destination = std::move(source);
+		else
+			destination.insert(destination.end(), source.begin(), source.end());
+	}
+
+	/**
+	 * \brief Open addressing table from v/vt/vn index combinations to the vertex made for them.
+	 * Entries are probed linearly and the table doubles before it gets half full
+	 */
+	class VertexTable final
+	{
+	public:
+		explicit VertexTable(size_t expectedCount)
+		{
+			Resize(std::bit_ceil(std::max(expectedCount * 2, size_t{ 64 })));
+		}
+
+		// vertex of the combination, newVertex when it wasn't in the table yet
+		int FindOrAdd(int position, int texCoord, int normal, int newVertex)
+		{
+			if ((m_Count + 1) * 2 > m_Entries.size())
+				Resize(m_Entries.size() * 2);
+
+			for (size_t slot{ Hash(position, texCoord, normal) & m_Mask };; slot = (slot + 1) & m_Mask)
+			{
+				Entry& entry{ m_Entries[slot] };
+				if (entry.vertex < 0)
+				{
+					entry = { position, texCoord, normal, newVertex };
+					++m_Count;
+					return newVertex;
+				}
+
+				if (entry.position == position && entry.texCoord == texCoord && entry.normal == normal)
+					return entry.vertex;
+			}
+		}
+
+	private:
+		// free while vertex is negative
+		struct Entry
+		{
+			int position{};
+			int texCoord{};
+			int normal{};
+			int vertex{ -1 };
+		};
+
+		static size_t Hash(int position, int texCoord, int normal)
+		{
+			uint64_t hash{ static_cast<uint32_t>(position) * 0x9E3779B97F4A7C15ull };
+			hash ^= static_cast<uint32_t>(texCoord) * 0xC2B2AE3D27D4EB4Full;
+			hash ^= static_cast<uint32_t>(normal) * 0x165667B19E3779F9ull;
+			return static_cast<size_t>(hash ^ (hash >> 32));
+		}
+
+		void Resize(size_t size)
+		{
+			std::vector<Entry> entries(size);
+			std::swap(entries, m_Entries);
+			m_Mask = size - 1;
+
+			for (const Entry& entry : entries)
+			{
+				if (entry.vertex < 0)
+					continue;
+
+				size_t slot{ Hash(entry.position, entry.texCoord, entry.normal) & m_Mask };
+				while (m_Entries[slot].vertex >= 0)
+					slot = (slot + 1) & m_Mask;
+				m_Entries[slot] = entry;
+			}
+		}
+
+		std::vector<Entry> m_Entries{};
+		size_t m_Mask{};
+		size_t m_Count{};
+	};
+
+	template<typename T>
+	void WriteArray(std::ofstream& file, const std::vector<T>& values)
+	{
+		file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	template<typename T>
+	void ReadArray(const char*& pData, size_t count, std::vector<T>& values)
+	{
+		values.resize(count);
+		std::memcpy(values.data(), pData, count * sizeof(T));
+		pData += count * sizeof(T);
+	}
+}
+
+bool OBJLoader::Load(const std::string& filename, OBJMesh& mesh, bool useCache)
+{
+	OBJMesh fileMesh{};
+
+	// taken before parsing, a file changing halfway through gets a cache that doesn't match it
+	CacheHeader header{};
+	useCache = useCache && MakeCacheHeader(filename, header);
+
+	if (!useCache || !ReadCache(filename, header, fileMesh))
+	{
+		if (!Parse(filename, fileMesh))
+			return false;
+
+		if (useCache)
+			WriteCache(filename, header, fileMesh);
+	}
+
+	mesh = std::move(fileMesh);
+	return true;
+}
+
+bool OBJLoader::Load(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool useCache)
+{
+	OBJMesh mesh{};
+	if (!Load(filename, mesh, useCache))
+		return false;
+
+	Append(positions, std::move(mesh.positions));
+	Append(normals, std::move(mesh.faceNormals));
+	Append(indices, std::move(mesh.indices));
+	return true;
+}
+
+bool OBJLoader::Parse(const std::string& filename, OBJMesh& mesh)
+{
+	MappedFile file{};
+	if (!file.Open(filename))
+		return false;
+
+	const char* pData{ file.GetData() };
+	const char* pDataEnd{ pData + file.GetSize() };
+	const size_t chunkCount{ std::max(file.GetSize() / ChunkSize, size_t{ 1 }) };
+
+	// every chunk runs to the end of the line its share of the file stops in
+	std::vector<Chunk> chunks(chunkCount);
+	const char* pBegin{ pData };
+	for (size_t chunkIndex{}; chunkIndex < chunkCount; ++chunkIndex)
+	{
+		const char* pEnd{ pDataEnd };
+		if (chunkIndex + 1 < chunkCount)
+		{
+			const char* pLineEnd{ FindLineEnd(std::max(pData + (chunkIndex + 1) * file.GetSize() / chunkCount, pBegin), pDataEnd) };
+			pEnd = pLineEnd < pDataEnd ? pLineEnd + 1 : pDataEnd;
+		}
+
+		chunks[chunkIndex].pBegin = pBegin;
+		chunks[chunkIndex].pEnd = pEnd;
+		pBegin = pEnd;
+	}
+
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(), ParseChunk);
+
+	size_t positionCount{};
+	size_t normalCount{};
+	size_t texCoordCount{};
+	size_t cornerCount{};
+	bool hasTexCoords{};
+	bool hasNormals{};
+	for (Chunk& chunk : chunks)
+	{
+		if (!chunk.isValid)
+			return false;
+
+		chunk.firstPosition = positionCount;
+		chunk.firstNormal = normalCount;
+		chunk.firstTexCoord = texCoordCount;
+		chunk.firstCorner = cornerCount;
+		positionCount += chunk.positions.size();
+		normalCount += chunk.normals.size();
+		texCoordCount += chunk.texCoords.size();
+		cornerCount += chunk.corners.size();
+		hasTexCoords = hasTexCoords || chunk.hasTexCoords;
+		hasNormals = hasNormals || chunk.hasNormals;
+	}
+
+	// every corner can become a vertex of its own
+	if (positionCount > INT_MAX || normalCount > INT_MAX || texCoordCount > INT_MAX || cornerCount > INT_MAX)
+		return false;
+
+	// faces can point at what any chunk defined, they can only be checked once all of it is counted
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+		[=](Chunk& chunk)
+		{
+			chunk.isValid = ResolveCorners(chunk, positionCount, normalCount, texCoordCount);
+		});
+
+	if (std::any_of(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return !chunk.isValid; }))
+		return false;
+
+	std::vector<Vector3> filePositions(positionCount);
+	std::vector<Vector3> fileNormals(normalCount);
+	std::vector<Vector3> fileTexCoords(texCoordCount);
+
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+		[&](const Chunk& chunk)
+		{
+			std::copy(chunk.positions.begin(), chunk.positions.end(), filePositions.begin() + chunk.firstPosition);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), fileNormals.begin() + chunk.firstNormal);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), fileTexCoords.begin() + chunk.firstTexCoord);
+		});
+
+	// lists nothing points at are left out of the mesh
+	if (!hasNormals)
+		fileNormals.clear();
+	if (!hasTexCoords)
+		fileTexCoords.clear();
+
+	BuildVertices(chunks, filePositions, fileNormals, fileTexCoords, mesh);
+
+	// the normals need every vertex in place, so they come in a pass of their own
+	mesh.faceNormals.resize(cornerCount / 3);
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+		[&](const Chunk& chunk)
+		{
+			const size_t endCorner{ chunk.firstCorner + chunk.corners.size() };
+			for (size_t index{ chunk.firstCorner }; index < endCorner; index += 3)
+			{
+				const Vector3& v0{ mesh.positions[mesh.indices[index]] };
+				const Vector3 edgeV0V1{ mesh.positions[mesh.indices[index + 1]] - v0 };
+				const Vector3 edgeV0V2{ mesh.positions[mesh.indices[index + 2]] - v0 };
+
+				Vector3 normal{ Vector3::Cross(edgeV0V1, edgeV0V2) };
+				normal.Normalize();
+
+				mesh.faceNormals[index / 3] = normal;
+			}
+		});
+
+	BuildGroups(chunks, mesh);
+	return true;
+}
+
+void OBJLoader::ParseChunk(Chunk& chunk)
+{
+	for (const char* pLine{ chunk.pBegin }; pLine < chunk.pEnd && chunk.isValid;)
+	{
+		const char* pLineEnd{ FindLineEnd(pLine, chunk.pEnd) };
+		const char* p{ SkipSpaces(pLine, pLineEnd) };
+
+		// the extra w of a position and the vertex colors some exporters add are ignored
+		if (IsCommand(p, pLineEnd, "v"))
+		{
+			++p;
+
+			Vector3 position{};
+			chunk.isValid = ParseFloat(p, pLineEnd, position.x) && ParseFloat(p, pLineEnd, position.y) && ParseFloat(p, pLineEnd, position.z);
+			chunk.positions.push_back(position);
+		}
+		else if (IsCommand(p, pLineEnd, "f"))
+		{
+			chunk.isValid = ParseFace(chunk, p + 1, pLineEnd);
+		}
+		else if (IsCommand(p, pLineEnd, "vn"))
+		{
+			p += 2;
+
+			Vector3 normal{};
+			chunk.isValid = ParseFloat(p, pLineEnd, normal.x) && ParseFloat(p, pLineEnd, normal.y) && ParseFloat(p, pLineEnd, normal.z);
+			chunk.normals.push_back(normal);
+		}
+		else if (IsCommand(p, pLineEnd, "vt"))
+		{
+			p += 2;
+
+			// only u has to be there, v and w default to zero
+			Vector3 texCoord{};
+			chunk.isValid = ParseFloat(p, pLineEnd, texCoord.x) &&
+				(IsLineDone(p, pLineEnd) || ParseFloat(p, pLineEnd, texCoord.y)) &&
+				(IsLineDone(p, pLineEnd) || ParseFloat(p, pLineEnd, texCoord.z));
+			chunk.texCoords.push_back(texCoord);
+		}
+		else if (IsCommand(p, pLineEnd, "o") || IsCommand(p, pLineEnd, "g"))
+		{
+			chunk.groupChanges.push_back({ static_cast<uint32_t>(chunk.corners.size()), false, ParseName(p + 1, pLineEnd) });
+		}
+		else if (IsCommand(p, pLineEnd, "usemtl"))
+		{
+			chunk.groupChanges.push_back({ static_cast<uint32_t>(chunk.corners.size()), true, ParseName(p + 6, pLineEnd) });
+		}
+
+		pLine = pLineEnd < chunk.pEnd ? pLineEnd + 1 : chunk.pEnd;
+	}
+}
+
+bool OBJLoader::ParseFace(Chunk& chunk, const char* p, const char* pLineEnd)
+{
+	// a polygon becomes the triangles (first, previous, corner) for every corner after the second
+	FaceVertex first{};
+	FaceVertex previous{};
+	int cornerCount{};
+
+	while (!IsLineDone(p, pLineEnd))
+	{
+		FaceVertex corner{};
+		if (!ParseFaceVertex(chunk, p, pLineEnd, corner))
+			return false;
+
+		// a negative index can still be -1 here
+		chunk.hasTexCoords = chunk.hasTexCoords || corner.texCoord != -1 || (corner.relativeMask & RelativeTexCoord);
+		chunk.hasNormals = chunk.hasNormals || corner.normal != -1 || (corner.relativeMask & RelativeNormal);
+
+		if (cornerCount == 0)
+			first = corner;
+		else if (cornerCount >= 2)
+		{
+			for (const FaceVertex& triangleCorner : { first, previous, corner })
+			{
+				if (triangleCorner.relativeMask)
+					chunk.relativeCorners.push_back(static_cast<uint32_t>(chunk.corners.size()));
+				chunk.corners.push_back(triangleCorner);
+			}
+		}
+
+		previous = corner;
+		++cornerCount;
+	}
+
+	return cornerCount >= 3;
+}
+
+bool OBJLoader::ParseFaceVertex(const Chunk& chunk, const char*& p, const char* pLineEnd, FaceVertex& corner)
+{
+	p = SkipSpaces(p, pLineEnd);
+
+	bool isRelative{};
+	if (!ParseIndex(p, pLineEnd, chunk.positions.size(), corner.position, isRelative))
+		return false;
+	if (isRelative)
+		corner.relativeMask |= RelativePosition;
+
+	// v, v/vt, v//vn or v/vt/vn
+	if (p < pLineEnd && *p == '/')
+	{
+		++p;
+		if (p < pLineEnd && *p != '/')
+		{
+			if (!ParseIndex(p, pLineEnd, chunk.texCoords.size(), corner.texCoord, isRelative))
+				return false;
+			if (isRelative)
+				corner.relativeMask |= RelativeTexCoord;
+		}
+
+		if (p < pLineEnd && *p == '/')
+		{
+			++p;
+			if (!ParseIndex(p, pLineEnd, chunk.normals.size(), corner.normal, isRelative))
+				return false;
+			if (isRelative)
+				corner.relativeMask |= RelativeNormal;
+		}
+	}
+
+	return p == pLineEnd || IsSpace(*p) || *p == '\r';
+}
+
+bool OBJLoader::ResolveCorners(Chunk& chunk, size_t positionCount, size_t normalCount, size_t texCoordCount)
+{
+	for (const uint32_t cornerIndex : chunk.relativeCorners)
+	{
+		FaceVertex& corner{ chunk.corners[cornerIndex] };
+		if (corner.relativeMask & RelativePosition)
+			corner.position += static_cast<int>(chunk.firstPosition);
+		if (corner.relativeMask & RelativeTexCoord)
+			corner.texCoord += static_cast<int>(chunk.firstTexCoord);
+		if (corner.relativeMask & RelativeNormal)
+			corner.normal += static_cast<int>(chunk.firstNormal);
+
+		// counted back past the start of the file, a -1 would pass for a missing index below
+		if (corner.position < 0 || ((corner.relativeMask & RelativeTexCoord) && corner.texCoord < 0) ||
+			((corner.relativeMask & RelativeNormal) && corner.normal < 0))
+			return false;
+
+		corner.relativeMask = 0;
+	}
+
+	// -1 is a missing index and wraps around to the largest value
+	return std::all_of(chunk.corners.begin(), chunk.corners.end(),
+		[&](const FaceVertex& corner)
+		{
+			return static_cast<size_t>(corner.position) < positionCount &&
+				(corner.texCoord == -1 || static_cast<size_t>(corner.texCoord) < texCoordCount) &&
+				(corner.normal == -1 || static_cast<size_t>(corner.normal) < normalCount);
+		});
+}
+
+void OBJLoader::BuildVertices(const std::vector<Chunk>& chunks, std::vector<Vector3>& filePositions, const std::vector<Vector3>& fileNormals,
+	const std::vector<Vector3>& fileTexCoords, OBJMesh& mesh)
+{
+	size_t cornerCount{};
+	for (const Chunk& chunk : chunks)
+		cornerCount += chunk.corners.size();
+
+	mesh.indices.resize(cornerCount);
+
+	// with only positions in the faces every position already is a vertex, nothing needs to be looked up
+	if (fileNormals.empty() && fileTexCoords.empty())
+	{
+		mesh.positions = std::move(filePositions);
+
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+			[&](const Chunk& chunk)
+			{
+				std::transform(chunk.corners.begin(), chunk.corners.end(), mesh.indices.begin() + chunk.firstCorner,
+					[](const FaceVertex& corner) { return corner.position; });
+			});
+		return;
+	}
+
+	// vertices are numbered in the order the faces first use them, so this stays on one thread
+	VertexTable table{ filePositions.size() };
+	mesh.positions.reserve(filePositions.size());
+	size_t index{};
+
+	for (const Chunk& chunk : chunks)
+	{
+		for (const FaceVertex& corner : chunk.corners)
+		{
+			const int newVertex{ static_cast<int>(mesh.positions.size()) };
+			const int vertex{ table.FindOrAdd(corner.position, corner.texCoord, corner.normal, newVertex) };
+
+			if (vertex == newVertex)
+			{
+				mesh.positions.push_back(filePositions[corner.position]);
+				if (!fileNormals.empty())
+					mesh.normals.push_back(corner.normal >= 0 ? fileNormals[corner.normal] : Vector3{});
+				if (!fileTexCoords.empty())
+					mesh.texCoords.push_back(corner.texCoord >= 0 ? fileTexCoords[corner.texCoord] : Vector3{});
+			}
+
+			mesh.indices[index++] = vertex;
+		}
+	}
+}
+
+void OBJLoader::BuildGroups(const std::vector<Chunk>& chunks, OBJMesh& mesh)
+{
+	// triangles before the first o, g or usemtl line land in a group without a name or material
+	mesh.groups.clear();
+	mesh.groups.emplace_back();
+
+	for (const Chunk& chunk : chunks)
+	{
+		for (const GroupChange& change : chunk.groupChanges)
+		{
+			// changes without triangles between them all go to the same group
+			const uint32_t firstIndex{ static_cast<uint32_t>(chunk.firstCorner + change.firstCorner) };
+			if (firstIndex > mesh.groups.back().firstIndex)
+			{
+				OBJMesh::Group group{ mesh.groups.back() };
+				mesh.groups.back().indexCount = firstIndex - group.firstIndex;
+				group.firstIndex = firstIndex;
+				mesh.groups.push_back(std::move(group));
+			}
+
+			OBJMesh::Group& group{ mesh.groups.back() };
+			(change.isMaterial ? group.material : group.name) = change.value;
+		}
+	}
+
+	mesh.groups.back().indexCount = static_cast<uint32_t>(mesh.indices.size()) - mesh.groups.back().firstIndex;
+
+	std::erase_if(mesh.groups, [](const OBJMesh::Group& group) { return group.indexCount == 0; });
+}
+
+bool OBJLoader::MakeCacheHeader(const std::string& filename, CacheHeader& header)
+{
+	std::error_code error{};
+
+	const uintmax_t size{ std::filesystem::file_size(filename, error) };
+	if (error)
+		return false;
+
+	const std::filesystem::file_time_type time{ std::filesystem::last_write_time(filename, error) };
+	if (error)
+		return false;
+
+	header = {};
+	header.magic = CacheMagic;
+	header.version = CacheVersion;
+	header.sourceSize = size;
+	header.sourceTime = static_cast<int64_t>(time.time_since_epoch().count());
+	return true;
+}
+
+bool OBJLoader::ReadCache(const std::string& filename, const CacheHeader& expectedHeader, OBJMesh& mesh)
+{
+	static_assert(std::is_trivially_copyable_v<CacheHeader> && std::is_trivially_copyable_v<Vector3>, "Cache arrays are copied byte for byte");
+
+	MappedFile cache{};
+	if (!cache.Open(filename + CacheExtension) || cache.GetSize() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header{};
+	std::memcpy(&header, cache.GetData(), sizeof(CacheHeader));
+
+	if (header.magic != expectedHeader.magic || header.version != expectedHeader.version ||
+		header.sourceSize != expectedHeader.sourceSize || header.sourceTime != expectedHeader.sourceTime)
+		return false;
+
+	// a cache cut short while it was being written has the wrong size, the count checks keep the sum from overflowing
+	const uint64_t cacheSize{ cache.GetSize() };
+	if (header.positionCount > cacheSize || header.normalCount > cacheSize || header.texCoordCount > cacheSize ||
+		header.indexCount > cacheSize || header.groupCount > cacheSize || header.groupBytes > cacheSize)
+		return false;
+
+	const size_t faceCount{ header.indexCount / 3 };
+	const size_t arrayBytes{ (header.positionCount + header.normalCount + header.texCoordCount + faceCount) * sizeof(Vector3) + header.indexCount * sizeof(int) };
+	if (cacheSize != sizeof(CacheHeader) + arrayBytes + header.groupBytes)
+		return false;
+
+	const char* pData{ cache.GetData() + sizeof(CacheHeader) };
+
+	OBJMesh cacheMesh{};
+	ReadArray(pData, header.positionCount, cacheMesh.positions);
+	ReadArray(pData, header.normalCount, cacheMesh.normals);
+	ReadArray(pData, header.texCoordCount, cacheMesh.texCoords);
+	ReadArray(pData, header.indexCount, cacheMesh.indices);
+	ReadArray(pData, faceCount, cacheMesh.faceNormals);
+
+	// the group blob is only as trustworthy as its size, every length in it is checked against what is left
+	const char* pDataEnd{ pData + header.groupBytes };
+	cacheMesh.groups.resize(header.groupCount);
+	for (OBJMesh::Group& group : cacheMesh.groups)
+	{
+		uint32_t fields[4]{};
+		if (static_cast<size_t>(pDataEnd - pData) < sizeof(fields))
+			return false;
+
+		std::memcpy(fields, pData, sizeof(fields));
+		pData += sizeof(fields);
+
+		if (static_cast<size_t>(pDataEnd - pData) < uint64_t{ fields[2] } + fields[3])
+			return false;
+
+		group.firstIndex = fields[0];
+		group.indexCount = fields[1];
+		group.name.assign(pData, fields[2]);
+		pData += fields[2];
+		group.material.assign(pData, fields[3]);
+		pData += fields[3];
+	}
+
+	if (pData != pDataEnd)
+		return false;
+
+	mesh = std::move(cacheMesh);
+	return true;
+}
+
+void OBJLoader::WriteCache(const std::string& filename, CacheHeader header, const OBJMesh& mesh)
+{
+	header.positionCount = mesh.positions.size();
+	header.normalCount = mesh.normals.size();
+	header.texCoordCount = mesh.texCoords.size();
+	header.indexCount = mesh.indices.size();
+	header.groupCount = mesh.groups.size();
+	header.groupBytes = 0;
+	for (const OBJMesh::Group& group : mesh.groups)
+		header.groupBytes += 4 * sizeof(uint32_t) + group.name.size() + group.material.size();
+
+	// written to the side and renamed over the old cache, a load running at the same time never maps half a file
+	const std::string cacheName{ filename + CacheExtension };
+	const std::string tempName{ cacheName + ".tmp" };
+
+	bool isWritten{};
+	{
+		std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+		WriteArray(file, mesh.positions);
+		WriteArray(file, mesh.normals);
+		WriteArray(file, mesh.texCoords);
+		WriteArray(file, mesh.indices);
+		WriteArray(file, mesh.faceNormals);
+
+		for (const OBJMesh::Group& group : mesh.groups)
+		{
+			const uint32_t fields[4]{ group.firstIndex, group.indexCount, static_cast<uint32_t>(group.name.size()), static_cast<uint32_t>(group.material.size()) };
+			file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+			file.write(group.name.data(), group.name.size());
+			file.write(group.material.data(), group.material.size());
+		}
+
+		file.flush();
+		isWritten = file.good();
+	}
+
+	// a missing cache only costs the next load a parse, read-only folders are fine
+	std::error_code error{};
+	if (isWritten)
+		std::filesystem::rename(tempName, cacheName, error);
+
+	if (!isWritten || error)
+		std::filesystem::remove(tempName, error);
+}
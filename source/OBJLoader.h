@@ -0,0 +1,154 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Everything OBJLoader takes from a file, faces are triangulated and every distinct v/vt/vn combination is one vertex
+	struct OBJMesh
+	{
+		//Triangles between two o, g or usemtl lines, indexCount indices from firstIndex on
+		struct Group
+		{
+			std::string name{};
+			std::string material{};
+			uint32_t firstIndex{};
+			uint32_t indexCount{};
+		};
+
+		std::vector<Vector3> positions{};
+		//Indexed like positions, empty when no face names one. Vertices whose face didn't name one get zero
+		std::vector<Vector3> normals{};
+		std::vector<Vector3> texCoords{};
+
+		//Three per triangle, polygons are split in a fan around their first vertex
+		std::vector<int> indices{};
+		//One per triangle from its winding, whatever normals the file has
+		std::vector<Vector3> faceNormals{};
+
+		std::vector<Group> groups{};
+	};
+
+	/**
+	 * \brief Wavefront OBJ reader for triangle and polygon meshes.
+	 * The file is memory mapped and cut into chunks of whole lines that are parsed in parallel, the results are joined in file order.
+	 * Every parse leaves a binary cache next to the file, loading the same unchanged file again only maps that cache
+	 */
+	class OBJLoader final
+	{
+	public:
+		//The cache of a file is the file name with this appended
+		static constexpr const char* CacheExtension{ ".meshcache" };
+		//Caches written by another version are parsed over again and replaced
+		static constexpr uint32_t CacheVersion{ 2 };
+
+		//Files are cut in chunks of about this many bytes, smaller files are parsed as one chunk
+		static constexpr size_t ChunkSize{ 1 << 20 };
+
+		/**
+		 * \brief Reads v, vn, vt, f, o, g and usemtl lines into mesh, replacing what it held. Every other kind of line is skipped.
+		 * Faces take any number of v, v/vt, v//vn or v/vt/vn vertices, negative indices count back from the last one defined so far
+		 * \return false when the file can't be read, one of those lines doesn't parse or a face points past what was defined.
+		 * The mesh is left alone then
+		 */
+		static bool Load(const std::string& filename, OBJMesh& mesh, bool useCache = true);
+
+		//Appends the positions, three zero based indices per triangle and the normal of every triangle, the rest of the file is dropped
+		static bool Load(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool useCache = true);
+
+	private:
+		//Triangle corner as written in the file, zero based with -1 for a missing texture coordinate or normal
+		struct FaceVertex
+		{
+			int position{};
+			int texCoord{ -1 };
+			int normal{ -1 };
+
+			//RelativePosition | RelativeTexCoord | RelativeNormal for the negative indices,
+			//those are counted back from the end of their chunk and still miss what the chunks before it defined
+			uint8_t relativeMask{};
+		};
+
+		static constexpr uint8_t RelativePosition{ 1 };
+		static constexpr uint8_t RelativeTexCoord{ 2 };
+		static constexpr uint8_t RelativeNormal{ 4 };
+
+		//o, g or usemtl line, it applies from corner firstCorner of its chunk on
+		struct GroupChange
+		{
+			uint32_t firstCorner{};
+			bool isMaterial{};
+			std::string value{};
+		};
+
+		//Lines [pBegin, pEnd) of the file and what they hold
+		struct Chunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<Vector3> texCoords{};
+
+			//Three per triangle, polygons are already split
+			std::vector<FaceVertex> corners{};
+			//Corners with a relativeMask
+			std::vector<uint32_t> relativeCorners{};
+			std::vector<GroupChange> groupChanges{};
+
+			//Where the chunk goes in the joined lists
+			size_t firstPosition{};
+			size_t firstNormal{};
+			size_t firstTexCoord{};
+			size_t firstCorner{};
+
+			bool hasTexCoords{};
+			bool hasNormals{};
+			bool isValid{ true };
+		};
+
+		//Start of a cache file, followed by the positions, normals, texture coordinates, indices, face normals and groups in that order
+		struct CacheHeader
+		{
+			uint32_t magic{};
+			uint32_t version{};
+
+			//Size and last write time of the OBJ file the cache was made from
+			uint64_t sourceSize{};
+			int64_t sourceTime{};
+
+			uint64_t positionCount{};
+			uint64_t normalCount{};
+			uint64_t texCoordCount{};
+			uint64_t indexCount{};
+			uint64_t groupCount{};
+			//Every group is its first index, index count, name length and material length as uint32_t, then the name and material
+			uint64_t groupBytes{};
+		};
+
+		static constexpr uint32_t CacheMagic{ 0x4853454D }; // "MESH"
+
+		static bool Parse(const std::string& filename, OBJMesh& mesh);
+		static void ParseChunk(Chunk& chunk);
+		static bool ParseFace(Chunk& chunk, const char* p, const char* pLineEnd);
+		static bool ParseFaceVertex(const Chunk& chunk, const char*& p, const char* pLineEnd, FaceVertex& corner);
+
+		//Adds the offsets of the chunks before it to the relative corners and checks every corner against the joined lists
+		static bool ResolveCorners(Chunk& chunk, size_t positionCount, size_t normalCount, size_t texCoordCount);
+		//Turns the corners into vertices and indices, one vertex per distinct corner when the faces name normals or texture coordinates
+		static void BuildVertices(const std::vector<Chunk>& chunks, std::vector<Vector3>& filePositions, const std::vector<Vector3>& fileNormals,
+			const std::vector<Vector3>& fileTexCoords, OBJMesh& mesh);
+		static void BuildGroups(const std::vector<Chunk>& chunks, OBJMesh& mesh);
+
+		//Header a cache of the file as it is right now starts with, without the counts
+		static bool MakeCacheHeader(const std::string& filename, CacheHeader& header);
+		static bool ReadCache(const std::string& filename, const CacheHeader& expectedHeader, OBJMesh& mesh);
+		static void WriteCache(const std::string& filename, CacheHeader header, const OBJMesh& mesh);
+	};
+}
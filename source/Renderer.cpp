@@ -7,27 +7,41 @@
 #include "Math.h"
 #include "Matrix.h"
 #include "Material.h"
+#include "LightBVH.h"
 #include "Scene.h"
 #include "Utils.h"
 
+//Standard includes
+#include <algorithm>
+#include <bit>
+#include <limits>
+
 #define PARALLEL_EXECUTION
-#ifdef PARALLEL_EXECUTION
-#include <execution>
-#endif
 
 using namespace dae;
 
-Renderer::Renderer(SDL_Window * pWindow) :
+Renderer::Renderer(SDL_Window * pWindow, uint32_t threadCount, bool pinThreads) :
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow))
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+
+#ifdef PARALLEL_EXECUTION
+	m_pThreadPool = std::make_unique<ThreadPool>(threadCount, pinThreads);
+#else
+	(void)threadCount;
+	(void)pinThreads;
+#endif
+
+	BuildTiles();
 }
 
 void Renderer::Render(Scene* pScene) const
 {
+	pScene->UpdateAccelerationStructure();
+
 	Camera& camera = pScene->GetCamera();
 	const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
 
@@ -37,24 +51,26 @@ void Renderer::Render(Scene* pScene) const
 	const auto& lightVec{ pScene->GetLights() };
 	const auto& materialVec{ pScene->GetMaterials() };
 
-	const uint32_t nrPixels{ uint32_t(m_Width * m_Height) };
+	const auto renderTile{
+		[&](uint32_t tileIndex)
+		{
+			const Tile& tile{ m_Tiles[tileIndex] };
 
-#ifdef PARALLEL_EXECUTION
-	std::vector<uint32_t> pixelIndexVec{};
+			// primary hits of the whole tile first, where they landed decides which lights the tile needs
+			thread_local TileHits tileHits{};
+			TraceTile(pScene, tile, fov, aspectRatio, cameraToWorld, camera.origin, tileHits);
 
-	pixelIndexVec.reserve(nrPixels);
-	for (uint32_t index{}; index < nrPixels; ++index) 
-		pixelIndexVec.emplace_back(index);
+			thread_local std::vector<uint32_t> tileLights{};
+			GatherTileLights(pScene->GetLightBVH(), tile, tileHits, materialVec, tileLights);
 
-	std::for_each(std::execution::par, pixelIndexVec.begin(), pixelIndexVec.end(), 
-		[&](int i) 
-		{
-			RenderOnePixel(pScene, i, fov, aspectRatio, cameraToWorld, camera.origin, materialVec, lightVec);
-		});
+			ShadeTile(pScene, tile, tileHits, materialVec, lightVec, tileLights);
+		} };
 
+#ifdef PARALLEL_EXECUTION
+	m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_Tiles.size()), renderTile);
 #else
-	for (uint32_t index{}; index < nrPixels; ++index)
-		RenderOnePixel(pScene, index, fov, aspectRatio, cameraToWorld, camera.origin, materialVec, lightVec);
+	for (uint32_t tileIndex{}; tileIndex < m_Tiles.size(); ++tileIndex)
+		renderTile(tileIndex);
 #endif
 
 	//@END
@@ -62,71 +78,203 @@ void Renderer::Render(Scene* pScene) const
 	SDL_UpdateWindowSurface(m_pWindow);
 }
 
-void Renderer::RenderOnePixel(	Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio,
-								const Matrix& cameraToWorld, const Vector3& cameraOrigin,
-								const std::vector<Material*>& materialVec, const std::vector<Light>& lightVec) const
+void Renderer::TraceTile(Scene* pScene, const Tile& tile, float fov, float aspectRatio,
+						 const Matrix& cameraToWorld, const Vector3& cameraOrigin, TileHits& tileHits) const
+{
+	const uint32_t endX{ tile.x + tile.width };
+	const uint32_t endY{ tile.y + tile.height };
+
+	if (m_UsePackets)
+	{
+		for (uint32_t py{ tile.y }; py < endY; py += RayPacket::Width)
+		{
+			for (uint32_t px{ tile.x }; px < endX; px += RayPacket::Width)
+				TracePacket(pScene, tile, px, py, std::min(px + RayPacket::Width, endX), std::min(py + RayPacket::Width, endY),
+					fov, aspectRatio, cameraToWorld, cameraOrigin, tileHits);
+		}
+		return;
+	}
+
+	for (uint32_t py{ tile.y }; py < endY; ++py)
+	{
+		for (uint32_t px{ tile.x }; px < endX; ++px)
+		{
+			const uint32_t hitIndex{ (px - tile.x) + (py - tile.y) * TileSize };
+
+			tileHits.rays[hitIndex] = { cameraOrigin, GetCameraDirection(px + 0.5f, py + 0.5f, fov, aspectRatio, cameraToWorld) };
+			tileHits.hits[hitIndex] = {};
+			pScene->GetClosestHit(tileHits.rays[hitIndex], tileHits.hits[hitIndex]);
+		}
+	}
+}
+
+void Renderer::TracePacket(Scene* pScene, const Tile& tile, uint32_t startX, uint32_t startY, uint32_t endX, uint32_t endY,
+						   float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin, TileHits& tileHits) const
+{
+	RayPacket packet;
+	packet.origin = cameraOrigin;
+
+	for (uint32_t lane{}; lane < RayPacket::Size; ++lane)
+	{
+		const uint32_t px{ startX + lane % RayPacket::Width };
+		const uint32_t py{ startY + lane / RayPacket::Width };
+
+		if (px >= endX || py >= endY)
+			continue;
+
+		packet.SetRay(lane, GetCameraDirection(px + 0.5f, py + 0.5f, fov, aspectRatio, cameraToWorld));
+		packet.activeMask |= 1u << lane;
+	}
+
+	// the outer pixel edges, not the pixel centers, so rays on the border stay inside the frustum
+	const float left{ static_cast<float>(startX) };
+	const float right{ static_cast<float>(endX) };
+	const float top{ static_cast<float>(startY) };
+	const float bottom{ static_cast<float>(endY) };
+
+	packet.cornerDirections[0] = GetCameraDirection(left, top, fov, aspectRatio, cameraToWorld);
+	packet.cornerDirections[1] = GetCameraDirection(right, top, fov, aspectRatio, cameraToWorld);
+	packet.cornerDirections[2] = GetCameraDirection(right, bottom, fov, aspectRatio, cameraToWorld);
+	packet.cornerDirections[3] = GetCameraDirection(left, bottom, fov, aspectRatio, cameraToWorld);
+	packet.hasFrustum = true;
+
+	HitRecord closestHits[RayPacket::Size]{};
+	pScene->GetClosestHits(packet, closestHits);
+
+	for (uint32_t lanes{ packet.activeMask }; lanes; lanes &= lanes - 1)
+	{
+		const uint32_t lane{ static_cast<uint32_t>(std::countr_zero(lanes)) };
+		const uint32_t hitIndex{ (startX - tile.x + lane % RayPacket::Width) + (startY - tile.y + lane / RayPacket::Width) * TileSize };
+
+		tileHits.rays[hitIndex] = { cameraOrigin, { packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane] } };
+		tileHits.hits[hitIndex] = closestHits[lane];
+	}
+}
+
+void Renderer::GatherTileLights(const LightBVH& lightBVH, const Tile& tile, const TileHits& tileHits, const std::vector<Material>& materialVec,
+								std::vector<uint32_t>& tileLights) const
 {
-	const uint32_t px{ pixelIndex % m_Width};
-	const uint32_t py{ pixelIndex / m_Width };
+	tileLights.clear();
+
+	// bounds of every point the tile sees, the world space version of the depth bounds of a forward+ tile
+	// and the most any of their materials reflects, the cutoff has to hold for all of them
+	AABB tileBounds{};
+	float maxReflectance{};
+	for (uint32_t y{}; y < tile.height; ++y)
+	{
+		for (uint32_t x{}; x < tile.width; ++x)
+		{
+			const HitRecord& hit{ tileHits.hits[x + y * TileSize] };
+			if (!hit.didHit)
+				continue;
+
+			tileBounds.Grow(hit.origin);
+			maxReflectance = std::max(maxReflectance, GetMaxReflectance(materialVec[hit.materialIndex]));
+		}
+	}
+
+	// nothing but background
+	if (tileBounds.minAABB.x > tileBounds.maxAABB.x)
+		return;
+
+	lightBVH.ForEachLight(tileBounds, GetRadianceCutoff(maxReflectance), [&](uint32_t lightIndex) { tileLights.push_back(lightIndex); });
+}
 
-	const float x{ (2 * (px + 0.5f) / m_Width - 1) * aspectRatio * fov };
-	const float y{ (1 - 2 * (py + 0.5f) / m_Height) * fov };
+//Direction through a point on the screen, (px, py) in pixels
+Vector3 Renderer::GetCameraDirection(float px, float py, float fov, float aspectRatio, const Matrix& cameraToWorld) const
+{
+	const float x{ (2 * px / m_Width - 1) * aspectRatio * fov };
+	const float y{ (1 - 2 * py / m_Height) * fov };
 
 	Vector3 rayDirection{ x, y, 1 };
 	rayDirection = cameraToWorld.TransformVector(rayDirection);
 	rayDirection.Normalize();
 
-	Ray viewRay{ cameraOrigin, rayDirection };
+	return rayDirection;
+}
 
-	ColorRGB finalColor{};
-	float reflectionValue{ 1.f };
+void Renderer::ShadeTile(Scene* pScene, const Tile& tile, TileHits& tileHits, const std::vector<Material>& materialVec,
+						 const std::vector<Light>& lightVec, const std::vector<uint32_t>& tileLights) const
+{
+	// counting sort on the material of every pixel, misses go in bin 0 and material m in bin m + 1
+	constexpr uint32_t BinCount{ std::numeric_limits<decltype(HitRecord::materialIndex)>::max() + 2 };
+	uint32_t binStarts[BinCount + 1]{};
 
-	for (int bounce{}; bounce < m_Bounces; ++bounce)
+	const auto getBin{ [](const HitRecord& hit) { return hit.didHit ? hit.materialIndex + 1u : 0u; } };
+
+	for (uint32_t y{}; y < tile.height; ++y)
 	{
-		// hitinfo
-		HitRecord closestHit{};
-		pScene->GetClosestHit(viewRay, closestHit);
+		for (uint32_t x{}; x < tile.width; ++x)
+			++binStarts[getBin(tileHits.hits[x + y * TileSize]) + 1];
+	}
 
-		if (closestHit.didHit)
+	for (uint32_t bin{}; bin < BinCount; ++bin)
+		binStarts[bin + 1] += binStarts[bin];
+
+	uint32_t binEnds[BinCount];
+	std::copy(binStarts, binStarts + BinCount, binEnds);
+
+	for (uint32_t y{}; y < tile.height; ++y)
+	{
+		for (uint32_t x{}; x < tile.width; ++x)
 		{
-			Material* material{ materialVec[closestHit.materialIndex] };
+			const uint32_t hitIndex{ x + y * TileSize };
+			tileHits.shadingOrder[binEnds[getBin(tileHits.hits[hitIndex])]++] = static_cast<uint16_t>(hitIndex);
+		}
+	}
+
+	// one bin at a time, the material is resolved once and every pixel of the bin runs the same shading code
+	// misses go through the bounce loop as well, their primary material is never looked at
+	for (uint32_t bin{}; bin < BinCount; ++bin)
+	{
+		if (binStarts[bin] == binStarts[bin + 1])
+			continue;
 
-			for (const Light& light : lightVec)
+		std::visit([&](const auto& material)
 			{
-				// get light to closesthit
-				const Vector3 invertedLightDirection{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
-				const float length{ invertedLightDirection.Magnitude() - FLT_EPSILON };
-				Ray invertedLightRay{ closestHit.origin + closestHit.normal * FLT_EPSILON, invertedLightDirection.Normalized(), FLT_EPSILON, length };
+				for (uint32_t index{ binStarts[bin] }; index < binStarts[bin + 1]; ++index)
+				{
+					const uint32_t hitIndex{ tileHits.shadingOrder[index] };
+					ShadePixel(pScene, tile.x + hitIndex % TileSize, tile.y + hitIndex / TileSize, tileHits.rays[hitIndex], tileHits.hits[hitIndex],
+						material, materialVec, lightVec, tileLights);
+				}
+			}, materialVec[bin > 0 ? bin - 1 : 0]);
+	}
+}
 
-				// if it hits, the object is being blocked => darken
-				if (pScene->DoesHit(invertedLightRay) && m_EnableShadows)
-					continue;
+template<typename MaterialType>
+void Renderer::ShadePixel(	Scene* pScene, uint32_t px, uint32_t py, const Ray& primaryRay, const HitRecord& primaryHit, const MaterialType& primaryMaterial,
+							const std::vector<Material>& materialVec, const std::vector<Light>& lightVec, const std::vector<uint32_t>& tileLights) const
+{
+	Ray viewRay{ primaryRay };
 
-				const float observedArea{ Vector3::Dot(invertedLightRay.direction, closestHit.normal) };
-				const ColorRGB radiance{ LightUtils::GetRadiance(light, closestHit.origin) };
-				const ColorRGB materialShading{ material->Shade(closestHit, invertedLightRay.direction, -viewRay.direction) };
-				ColorRGB lighting{};
+	ColorRGB finalColor{};
+	float reflectionValue{ 1.f };
 
-				if (observedArea < 0)
-					continue;
+	for (int bounce{}; bounce < m_Bounces; ++bounce)
+	{
+		// hitinfo, the primary hit was already traced and sorted by material by the caller
+		HitRecord closestHit{ primaryHit };
+		if (bounce > 0)
+		{
+			closestHit = {};
+			pScene->GetClosestHit(viewRay, closestHit);
+		}
 
-				switch (m_LightingMode)
-				{
-				case LightingMode::ObservedArea:
-					finalColor += colors::White * observedArea;
-					continue;
-				case LightingMode::Radiance:
-					lighting = radiance;
-					break;
-				case LightingMode::BRDF:
-					lighting = materialShading;
-					break;
-				case LightingMode::Combined:
-					lighting = radiance * materialShading * observedArea;
-					break;
-				}
+		const uint32_t seed{ static_cast<uint32_t>((px + py * m_Width) * m_Bounces + bounce) };
 
-				finalColor += lighting * reflectionValue;
+		if (closestHit.didHit)
+		{
+			if (bounce == 0)
+			{
+				finalColor += ShadeHit(pScene, closestHit, primaryMaterial, viewRay.direction, reflectionValue, lightVec, &tileLights, seed);
+			}
+			else
+			{
+				finalColor += std::visit([&](const auto& material)
+					{
+						return ShadeHit(pScene, closestHit, material, viewRay.direction, reflectionValue, lightVec, nullptr, seed);
+					}, materialVec[closestHit.materialIndex]);
 			}
 		}
 
@@ -137,13 +285,317 @@ void Renderer::RenderOnePixel(	Scene* pScene, uint32_t pixelIndex, float fov, fl
 			reflectionValue /= 2;
 	}
 
+	WritePixel(px, py, finalColor);
+}
+
+template<typename MaterialType>
+ColorRGB Renderer::ShadeHit(Scene* pScene, const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+							const std::vector<Light>& lightVec, const std::vector<uint32_t>* pTileLights, uint32_t seed) const
+{
+	const LightBVH& lightBVH{ pScene->GetLightBVH() };
+
+	// unshadowed contribution of every light first, negligible ones never get a shadow ray
+	// with hundreds of lights only a few get traced, picked by how much they can contribute
+	thread_local std::vector<LightSample> lightSamples{};
+	if (m_UseStochasticLights && lightBVH.GetLightCount() > StochasticLightCount)
+		SampleLights(hit, material, viewDirection, reflectionValue, lightVec, lightBVH, seed, lightSamples);
+	else
+		GatherLightSamples(hit, material, viewDirection, reflectionValue, lightVec, lightBVH, pTileLights, lightSamples);
+
+	// brightest first, so the lights that matter most share the first shadow packets
+	std::sort(lightSamples.begin(), lightSamples.end(),
+		[](const LightSample& a, const LightSample& b) { return a.importance > b.importance; });
+
+	return GetUnoccludedLight(pScene, hit, lightSamples);
+}
+
+void Renderer::WritePixel(uint32_t px, uint32_t py, ColorRGB color) const
+{
 	// Update Color in Buffer
-	finalColor.MaxToOne();
+	color.MaxToOne();
 
 	m_pBufferPixels[int(px) + (int(py) * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+		static_cast<uint8_t>(color.r * 255),
+		static_cast<uint8_t>(color.g * 255),
+		static_cast<uint8_t>(color.b * 255));
+}
+
+template<typename MaterialType>
+void Renderer::GatherLightSamples(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+								  const std::vector<Light>& lightVec, const LightBVH& lightBVH, const std::vector<uint32_t>* pTileLights,
+								  std::vector<LightSample>& lightSamples) const
+{
+	lightSamples.clear();
+	PendingLights pendingLights{};
+
+	for (const uint32_t lightIndex : lightBVH.GetDirectionalLights())
+		AddLightSample(hit, material, viewDirection, reflectionValue, lightVec, lightIndex, 1.f, pendingLights, lightSamples);
+
+	const float radianceCutoff{ GetRadianceCutoff(material.GetMaxReflectance()) };
+
+	// the tile list already holds every light that reaches the tile, only the distance to this point is left to check
+	if (pTileLights)
+	{
+		for (const uint32_t lightIndex : *pTileLights)
+		{
+			const Light& light{ lightVec[lightIndex] };
+			if (light.color.MaxComponent() * light.intensity >= radianceCutoff * (light.origin - hit.origin).SqrMagnitude())
+				AddLightSample(hit, material, viewDirection, reflectionValue, lightVec, lightIndex, 1.f, pendingLights, lightSamples);
+		}
+	}
+	else
+	{
+		lightBVH.ForEachLight(hit.origin, hit.normal, radianceCutoff,
+			[&](uint32_t lightIndex)
+			{
+				AddLightSample(hit, material, viewDirection, reflectionValue, lightVec, lightIndex, 1.f, pendingLights, lightSamples);
+			});
+	}
+
+	FlushLightSamples(hit, material, viewDirection, reflectionValue, pendingLights, lightSamples);
+}
+
+template<typename MaterialType>
+void Renderer::SampleLights(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+							const std::vector<Light>& lightVec, const LightBVH& lightBVH, uint32_t seed, std::vector<LightSample>& lightSamples) const
+{
+	// PCG hash, the random numbers only depend on the seed so a pixel looks the same no matter which thread renders it
+	const auto nextRandom{
+		[&seed]()
+		{
+			seed = seed * 747796405u + 2891336453u;
+			uint32_t word{ ((seed >> ((seed >> 28u) + 4u)) ^ seed) * 277803737u };
+			word = (word >> 22u) ^ word;
+			return (word >> 8) * (1.f / 16777216.f);
+		} };
+
+	lightSamples.clear();
+	PendingLights pendingLights{};
+
+	for (const uint32_t lightIndex : lightBVH.GetDirectionalLights())
+		AddLightSample(hit, material, viewDirection, reflectionValue, lightVec, lightIndex, 1.f, pendingLights, lightSamples);
+
+	// every draw walks the light hierarchy down to one light, lights picked more than once share a shadow ray
+	uint32_t pickedLights[StochasticLightCount]{};
+	float pickedWeights[StochasticLightCount]{};
+	uint32_t pickedCount{};
+
+	for (uint32_t draw{}; draw < StochasticLightCount; ++draw)
+	{
+		uint32_t lightIndex{};
+		float probability{};
+		if (!lightBVH.SampleLight(hit.origin, hit.normal, nextRandom(), lightIndex, probability))
+			continue;
+
+		// weigh by 1 / (draws total * probability), on average the pixel gets the light of all of them
+		const float weight{ 1.f / (StochasticLightCount * probability) };
+
+		const auto pickedEnd{ pickedLights + pickedCount };
+		const auto it{ std::find(pickedLights, pickedEnd, lightIndex) };
+		if (it != pickedEnd)
+		{
+			pickedWeights[it - pickedLights] += weight;
+			continue;
+		}
+
+		pickedLights[pickedCount] = lightIndex;
+		pickedWeights[pickedCount++] = weight;
+	}
+
+	for (uint32_t index{}; index < pickedCount; ++index)
+		AddLightSample(hit, material, viewDirection, reflectionValue, lightVec, pickedLights[index], pickedWeights[index], pendingLights, lightSamples);
+
+	FlushLightSamples(hit, material, viewDirection, reflectionValue, pendingLights, lightSamples);
+}
+
+template<typename MaterialType>
+void Renderer::AddLightSample(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+							  const std::vector<Light>& lightVec, uint32_t lightIndex, float weight, PendingLights& pendingLights,
+							  std::vector<LightSample>& lightSamples) const
+{
+	const Light& light{ lightVec[lightIndex] };
+
+	// get light to closesthit
+	const Vector3 invertedLightDirection{ LightUtils::GetDirectionToLight(light, hit.origin) };
+	const Vector3 lightDirection{ invertedLightDirection.Normalized() };
+
+	// facing away from the light
+	const float observedArea{ Vector3::Dot(lightDirection, hit.normal) };
+	if (observedArea < 0)
+		return;
+
+	const uint32_t lane{ pendingLights.count++ };
+	pendingLights.shading.lights.Set(lane, lightDirection);
+	pendingLights.lightIndices[lane] = lightIndex;
+	pendingLights.distances[lane] = invertedLightDirection.Magnitude() - FLT_EPSILON;
+	pendingLights.observedAreas[lane] = observedArea;
+	pendingLights.weights[lane] = weight;
+
+	if (m_LightingMode == LightingMode::Radiance || m_LightingMode == LightingMode::Combined)
+		pendingLights.radiances[lane] = LightUtils::GetRadiance(light, hit.origin);
+
+	if (pendingLights.count == ShadingBatch::Size)
+		FlushLightSamples(hit, material, viewDirection, reflectionValue, pendingLights, lightSamples);
+}
+
+template<typename MaterialType>
+void Renderer::FlushLightSamples(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+								 PendingLights& pendingLights, std::vector<LightSample>& lightSamples) const
+{
+	if (pendingLights.count == 0)
+		return;
+
+	ShadingBatch& shading{ pendingLights.shading };
+
+	if (m_LightingMode == LightingMode::BRDF || m_LightingMode == LightingMode::Combined)
+	{
+		// every lane gets shaded, the unused ones repeat the first light instead of holding a stale or zero direction
+		for (uint32_t lane{ pendingLights.count }; lane < ShadingBatch::Size; ++lane)
+			shading.lights.Set(lane, shading.lights.Get(0));
+
+		material.Shade(hit, -viewDirection, shading);
+	}
+
+	for (uint32_t lane{}; lane < pendingLights.count; ++lane)
+	{
+		ColorRGB contribution{};
+
+		switch (m_LightingMode)
+		{
+		case LightingMode::ObservedArea:
+			contribution = colors::White * pendingLights.observedAreas[lane];
+			break;
+		case LightingMode::Radiance:
+			contribution = pendingLights.radiances[lane] * reflectionValue;
+			break;
+		case LightingMode::BRDF:
+			contribution = shading.GetColor(lane) * reflectionValue;
+			break;
+		case LightingMode::Combined:
+			contribution = pendingLights.radiances[lane] * shading.GetColor(lane) * pendingLights.observedAreas[lane] * reflectionValue;
+			break;
+		}
+
+		// too dark to show up in the final pixel, a sampled light stands in for the ones that weren't picked
+		contribution *= pendingLights.weights[lane];
+		const float importance{ contribution.MaxComponent() };
+		if (importance <= 0.f || importance < m_LightThreshold)
+			continue;
+
+		lightSamples.push_back({ pendingLights.lightIndices[lane], shading.lights.Get(lane), pendingLights.distances[lane], contribution, importance });
+	}
+
+	pendingLights.count = 0;
+}
+
+ColorRGB Renderer::GetUnoccludedLight(Scene* pScene, const HitRecord& hit, const std::vector<LightSample>& lightSamples) const
+{
+	ColorRGB light{};
+
+	if (!m_EnableShadows)
+	{
+		for (const LightSample& sample : lightSamples)
+			light += sample.contribution;
+
+		return light;
+	}
+
+	// the shadow rays towards the lights leave the same point, they are traced in packets
+	RayPacket shadowRays;
+	shadowRays.origin = hit.origin + hit.normal * FLT_EPSILON;
+	shadowRays.min = FLT_EPSILON;
+
+	uint32_t lightIndices[RayPacket::Size];
+
+	for (size_t firstSample{}; firstSample < lightSamples.size(); firstSample += RayPacket::Size)
+	{
+		const uint32_t sampleCount{ static_cast<uint32_t>(std::min(size_t{ RayPacket::Size }, lightSamples.size() - firstSample)) };
+		shadowRays.activeMask = (1u << sampleCount) - 1;
+
+		for (uint32_t lane{}; lane < sampleCount; ++lane)
+		{
+			const LightSample& sample{ lightSamples[firstSample + lane] };
+			shadowRays.SetRay(lane, sample.direction, sample.distance);
+			lightIndices[lane] = sample.lightIndex;
+		}
+
+		// if it hits, the object is being blocked => darken
+		// a couple of rays in different directions are cheaper to trace one by one
+		uint32_t occludedMask{};
+		if (m_UsePackets && static_cast<int>(sampleCount) >= MinBatchedShadowRays)
+		{
+			occludedMask = pScene->GetOcclusionMask(shadowRays, lightIndices);
+		}
+		else
+		{
+			for (uint32_t lane{}; lane < sampleCount; ++lane)
+			{
+				if (pScene->IsOccluded(shadowRays.GetRay(lane), lightIndices[lane]))
+					occludedMask |= 1u << lane;
+			}
+		}
+
+		for (uint32_t lane{}; lane < sampleCount; ++lane)
+		{
+			if (!(occludedMask & 1u << lane))
+				light += lightSamples[firstSample + lane].contribution;
+		}
+	}
+
+	return light;
+}
+
+float Renderer::GetRadianceCutoff(float maxReflectance) const
+{
+	// radiance can only be culled when it ends up in the lighting
+	switch (m_LightingMode)
+	{
+	case LightingMode::Radiance:
+		return m_LightThreshold;
+	case LightingMode::Combined:
+		// a BRDF can be well above 1, the radiance has to be as much darker for the product to stay under the threshold
+		return (maxReflectance > 0.f) ? m_LightThreshold / maxReflectance : m_LightThreshold;
+	default:
+		return 0.f;
+	}
+}
+
+void Renderer::BuildTiles()
+{
+	const uint32_t tileCountX{ (m_Width + TileSize - 1) / TileSize };
+	const uint32_t tileCountY{ (m_Height + TileSize - 1) / TileSize };
+
+	// interleave the bits of the tile coordinates, neighbouring tiles end up close in the list
+	const auto mortonCode{
+		[](uint32_t x, uint32_t y)
+		{
+			uint64_t code{};
+			for (uint32_t bit{}; bit < 16; ++bit)
+			{
+				code |= static_cast<uint64_t>((x >> bit) & 1) << (2 * bit);
+				code |= static_cast<uint64_t>((y >> bit) & 1) << (2 * bit + 1);
+			}
+			return code;
+		} };
+
+	m_Tiles.clear();
+	m_Tiles.reserve(tileCountX * tileCountY);
+
+	for (uint32_t tileY{}; tileY < tileCountY; ++tileY)
+	{
+		for (uint32_t tileX{}; tileX < tileCountX; ++tileX)
+		{
+			const uint32_t x{ tileX * TileSize };
+			const uint32_t y{ tileY * TileSize };
+			m_Tiles.push_back({ x, y, std::min(TileSize, m_Width - x), std::min(TileSize, m_Height - y) });
+		}
+	}
+
+	std::sort(m_Tiles.begin(), m_Tiles.end(),
+		[&](const Tile& a, const Tile& b)
+		{
+			return mortonCode(a.x / TileSize, a.y / TileSize) < mortonCode(b.x / TileSize, b.y / TileSize);
+		});
 }
 
 bool Renderer::SaveBufferToImage() const
@@ -151,6 +603,18 @@ bool Renderer::SaveBufferToImage() const
 	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
 }
 
+void Renderer::TogglePackets()
+{
+	m_UsePackets = !m_UsePackets;
+	std::cout << (m_UsePackets ? "Ray packets\n" : "Single rays\n");
+}
+
+void Renderer::ToggleStochasticLights()
+{
+	m_UseStochasticLights = !m_UseStochasticLights;
+	std::cout << (m_UseStochasticLights ? "Stochastic lights\n" : "All lights\n");
+}
+
 void Renderer::CycleLightMode()
 {
 	int modeIndex{ int(m_LightingMode) };
@@ -1,21 +1,25 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 
 #include "DataTypes.h"
+#include "Material.h"
+#include "ThreadPool.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
-	class Material;
+	class LightBVH;
 	class Scene;
 
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		// threadCount 0 uses every hardware thread, see ThreadPool
+		Renderer(SDL_Window* pWindow, uint32_t threadCount = 0, bool pinThreads = false);
 		~Renderer() = default;
 
 		Renderer(const Renderer&) = delete;
@@ -28,11 +32,107 @@ namespace dae
 
 		void CycleLightMode();
 		void ToggleShadows() { m_EnableShadows = !m_EnableShadows; }
+		void TogglePackets();
+		void ToggleStochasticLights();
+
+		//Lights adding less than this to every channel of a hit point are skipped before their shadow ray is traced
+		void SetLightThreshold(float threshold) { m_LightThreshold = threshold; }
 
 	private:
-		void RenderOnePixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, 
-							const Matrix& cameraToWorld, const Vector3& cameraOrigin, 
-							const std::vector<Material*>& materialVec, const std::vector<Light>& lightVec) const;
+		//Screen is rendered in tiles of TileSize x TileSize pixels, stored in Morton order
+		struct Tile
+		{
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+			uint32_t height;
+		};
+
+		//Unshadowed contribution of one light to a hit point
+		struct LightSample
+		{
+			uint32_t lightIndex;
+			Vector3 direction;
+			float distance;
+			ColorRGB contribution;
+			// brightest channel of the contribution, what the light can change at most in the final pixel
+			float importance;
+		};
+
+		//Lights that face a hit point and wait for their BRDF, it is evaluated for a whole ShadingBatch at once
+		struct PendingLights
+		{
+			ShadingBatch shading{};
+			uint32_t lightIndices[ShadingBatch::Size]{};
+			float distances[ShadingBatch::Size]{};
+			float observedAreas[ShadingBatch::Size]{};
+			float weights[ShadingBatch::Size]{};
+			ColorRGB radiances[ShadingBatch::Size]{};
+			uint32_t count{};
+		};
+
+		static constexpr uint32_t TileSize{ 16 };
+		//Fewer shadow rays than this per hit point are not worth tracing as a packet
+		static constexpr int MinBatchedShadowRays{ 4 };
+		//Point lights drawn per hit point in stochastic mode
+		static constexpr uint32_t StochasticLightCount{ 8 };
+
+		//G-buffer of one tile: primary rays and hits, pixel (x, y) of the tile is stored at x + y * TileSize
+		struct TileHits
+		{
+			Ray rays[TileSize * TileSize];
+			HitRecord hits[TileSize * TileSize];
+			//Pixels of the tile sorted by the material they hit, filled in by ShadeTile
+			uint16_t shadingOrder[TileSize * TileSize];
+		};
+
+		void BuildTiles();
+
+		//Traces the primary rays of a tile, as packets of RayPacket::Width x RayPacket::Width pixels when they are enabled
+		void TraceTile(Scene* pScene, const Tile& tile, float fov, float aspectRatio,
+					   const Matrix& cameraToWorld, const Vector3& cameraOrigin, TileHits& tileHits) const;
+		void TracePacket(Scene* pScene, const Tile& tile, uint32_t startX, uint32_t startY, uint32_t endX, uint32_t endY,
+						 float fov, float aspectRatio, const Matrix& cameraToWorld, const Vector3& cameraOrigin, TileHits& tileHits) const;
+		//Point lights that can reach any primary hit of the tile, the primary hits of the tile only look at these
+		void GatherTileLights(const LightBVH& lightBVH, const Tile& tile, const TileHits& tileHits, const std::vector<Material>& materialVec,
+							  std::vector<uint32_t>& tileLights) const;
+
+		Vector3 GetCameraDirection(float px, float py, float fov, float aspectRatio, const Matrix& cameraToWorld) const;
+		//Shading pass of a tile, shades its pixels grouped by material instead of in screen order
+		void ShadeTile(Scene* pScene, const Tile& tile, TileHits& tileHits, const std::vector<Material>& materialVec,
+					   const std::vector<Light>& lightVec, const std::vector<uint32_t>& tileLights) const;
+		//primaryMaterial is the material of primaryHit and unused when it missed, reflections look theirs up in materialVec
+		template<typename MaterialType>
+		void ShadePixel(Scene* pScene, uint32_t px, uint32_t py, const Ray& primaryRay, const HitRecord& primaryHit, const MaterialType& primaryMaterial,
+						const std::vector<Material>& materialVec, const std::vector<Light>& lightVec, const std::vector<uint32_t>& tileLights) const;
+		template<typename MaterialType>
+		ColorRGB ShadeHit(Scene* pScene, const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+						  const std::vector<Light>& lightVec, const std::vector<uint32_t>* pTileLights, uint32_t seed) const;
+		void WritePixel(uint32_t px, uint32_t py, ColorRGB color) const;
+
+		//Light loop of one hit point: contributions first, then shadow rays for the lights that are worth it
+		//MaterialType is the alternative the Material of the hit holds, so Shade is a direct call in the loop
+		//pTileLights replaces the point lights of lightBVH when it is set
+		template<typename MaterialType>
+		void GatherLightSamples(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+								const std::vector<Light>& lightVec, const LightBVH& lightBVH, const std::vector<uint32_t>* pTileLights,
+								std::vector<LightSample>& lightSamples) const;
+		//Stochastic mode, StochasticLightCount draws from the light hierarchy instead of every light that reaches the hit point
+		template<typename MaterialType>
+		void SampleLights(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+						  const std::vector<Light>& lightVec, const LightBVH& lightBVH, uint32_t seed, std::vector<LightSample>& lightSamples) const;
+		//Queues a light in pendingLights, they are turned into samples once the batch is full or by the last FlushLightSamples
+		template<typename MaterialType>
+		void AddLightSample(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+							const std::vector<Light>& lightVec, uint32_t lightIndex, float weight, PendingLights& pendingLights,
+							std::vector<LightSample>& lightSamples) const;
+		template<typename MaterialType>
+		void FlushLightSamples(const HitRecord& hit, const MaterialType& material, const Vector3& viewDirection, float reflectionValue,
+							   PendingLights& pendingLights, std::vector<LightSample>& lightSamples) const;
+		//Radiance a light has to reach at a point to be worth a sample, 0 in the lighting modes that leave radiance out
+		//maxReflectance bounds what the material there makes of it (see GetMaxReflectance), m_LightThreshold applies to the product
+		float GetRadianceCutoff(float maxReflectance) const;
+		ColorRGB GetUnoccludedLight(Scene* pScene, const HitRecord& hit, const std::vector<LightSample>& lightSamples) const;
 
 		enum class LightingMode
 		{
@@ -49,7 +149,15 @@ namespace dae
 
 		int m_Width{};
 		int m_Height{};
+
+		std::unique_ptr<ThreadPool> m_pThreadPool{};
+		std::vector<Tile> m_Tiles{};
+
 		bool m_EnableShadows{ true };
+		bool m_UsePackets{ true };
+		bool m_UseStochasticLights{ false };
+		//About half a step of an 8 bit channel
+		float m_LightThreshold{ 0.5f / 255 };
 		const int m_Bounces{ 1 };
 		LightingMode m_LightingMode{ LightingMode::Combined };
 	};
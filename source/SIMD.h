@@ -0,0 +1,292 @@
+#pragma once
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//Instruction sets the vectorized code paths can use, everything has a scalar fallback
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#define SIMD_SSE
+#include <immintrin.h>
+#endif
+
+#if defined(SIMD_SSE) && defined(__AVX2__)
+#define SIMD_AVX2
+#endif
+
+namespace dae
+{
+	/**
+	 * \brief Arithmetic that reads the same for a single float and for the vector registers of the enabled instruction sets.
+	 * Code written against these overloads is a template over the lane type, FloatLanes is the widest one this build has
+	 */
+	namespace SIMD
+	{
+#if defined(SIMD_AVX2)
+		using FloatLanes = __m256;
+#elif defined(SIMD_SSE)
+		using FloatLanes = __m128;
+#else
+		using FloatLanes = float;
+#endif
+		constexpr uint32_t LaneCount{ sizeof(FloatLanes) / sizeof(float) };
+
+		template<typename Lanes> Lanes Set1(float value);
+		template<typename Lanes> Lanes Load(const float* pValues);
+
+#pragma region Scalar
+		template<> inline float Set1<float>(float value) { return value; }
+		template<> inline float Load<float>(const float* pValues) { return *pValues; }
+		inline void Store(float* pValues, float value) { *pValues = value; }
+
+		inline float Add(float a, float b) { return a + b; }
+		inline float Sub(float a, float b) { return a - b; }
+		inline float Mul(float a, float b) { return a * b; }
+		inline float Div(float a, float b) { return a / b; }
+		inline float Min(float a, float b) { return a < b ? a : b; }
+		inline float Max(float a, float b) { return a > b ? a : b; }
+		inline float Sqrt(float a) { return sqrtf(a); }
+		inline bool LessEqual(float a, float b) { return a <= b; }
+		inline float Select(bool mask, float a, float b) { return mask ? a : b; }
+
+		inline float Floor(float a)
+		{
+			const float truncated{ static_cast<float>(static_cast<int32_t>(a)) };
+			return truncated > a ? truncated - 1.f : truncated;
+		}
+
+		//Unbiased exponent of a positive float, as a float
+		inline float GetExponent(float a)
+		{
+			uint32_t bits;
+			memcpy(&bits, &a, sizeof(bits));
+			return static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+		}
+
+		//Mantissa of a positive float, in [1, 2)
+		inline float GetMantissa(float a)
+		{
+			uint32_t bits;
+			memcpy(&bits, &a, sizeof(bits));
+			bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+			memcpy(&a, &bits, sizeof(bits));
+			return a;
+		}
+
+		//2^exponent for a whole exponent in [-126, 127]
+		inline float PowerOfTwo(float exponent)
+		{
+			const uint32_t bits{ static_cast<uint32_t>(static_cast<int32_t>(exponent) + 127) << 23 };
+			float result;
+			memcpy(&result, &bits, sizeof(bits));
+			return result;
+		}
+#pragma endregion
+
+#ifdef SIMD_SSE
+#pragma region SSE
+		template<> inline __m128 Set1<__m128>(float value) { return _mm_set1_ps(value); }
+		template<> inline __m128 Load<__m128>(const float* pValues) { return _mm_load_ps(pValues); }
+		inline void Store(float* pValues, __m128 value) { _mm_store_ps(pValues, value); }
+
+		inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+		inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+		inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+		inline __m128 Div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+		inline __m128 Min(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+		inline __m128 Max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+		inline __m128 Sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+		inline __m128 LessEqual(__m128 a, __m128 b) { return _mm_cmple_ps(a, b); }
+		inline __m128 Select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+		inline __m128 Floor(__m128 a)
+		{
+			// SSE2 only truncates, step down where that rounded up
+			const __m128 truncated{ _mm_cvtepi32_ps(_mm_cvttps_epi32(a)) };
+			return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.f)));
+		}
+
+		inline __m128 GetExponent(__m128 a)
+		{
+			const __m128i exponent{ _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(a), 23), _mm_set1_epi32(127)) };
+			return _mm_cvtepi32_ps(exponent);
+		}
+
+		inline __m128 GetMantissa(__m128 a)
+		{
+			const __m128i bits{ _mm_or_si128(_mm_and_si128(_mm_castps_si128(a), _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)) };
+			return _mm_castsi128_ps(bits);
+		}
+
+		inline __m128 PowerOfTwo(__m128 exponent)
+		{
+			const __m128i bits{ _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(exponent), _mm_set1_epi32(127)), 23) };
+			return _mm_castsi128_ps(bits);
+		}
+#pragma endregion
+#endif
+
+#ifdef SIMD_AVX2
+#pragma region AVX2
+		template<> inline __m256 Set1<__m256>(float value) { return _mm256_set1_ps(value); }
+		template<> inline __m256 Load<__m256>(const float* pValues) { return _mm256_load_ps(pValues); }
+		inline void Store(float* pValues, __m256 value) { _mm256_store_ps(pValues, value); }
+
+		inline __m256 Add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+		inline __m256 Sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+		inline __m256 Mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+		inline __m256 Div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+		inline __m256 Min(__m256 a, __m256 b) { return _mm256_min_ps(a, b); }
+		inline __m256 Max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+		inline __m256 Sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+		inline __m256 LessEqual(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		inline __m256 Select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); }
+		inline __m256 Floor(__m256 a) { return _mm256_floor_ps(a); }
+
+		inline __m256 GetExponent(__m256 a)
+		{
+			const __m256i exponent{ _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(a), 23), _mm256_set1_epi32(127)) };
+			return _mm256_cvtepi32_ps(exponent);
+		}
+
+		inline __m256 GetMantissa(__m256 a)
+		{
+			const __m256i bits{ _mm256_or_si256(_mm256_and_si256(_mm256_castps_si256(a), _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)) };
+			return _mm256_castsi256_ps(bits);
+		}
+
+		inline __m256 PowerOfTwo(__m256 exponent)
+		{
+			const __m256i bits{ _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(exponent), _mm256_set1_epi32(127)), 23) };
+			return _mm256_castsi256_ps(bits);
+		}
+#pragma endregion
+#endif
+
+#pragma region Approximations
+		/**
+		 * \brief log2 of a positive value, absolute error below 2.4e-6 over [1e-6, 100] (polynomial fitted to log2(1 + t) / t over the mantissa)
+		 */
+		template<typename Lanes>
+		Lanes FastLog2(Lanes a)
+		{
+			const Lanes t{ Sub(GetMantissa(a), Set1<Lanes>(1.f)) };
+
+			Lanes polynomial{ Set1<Lanes>(0.020490309f) };
+			polynomial = Add(Mul(polynomial, t), Set1<Lanes>(-0.096066140f));
+			polynomial = Add(Mul(polynomial, t), Set1<Lanes>(0.215588406f));
+			polynomial = Add(Mul(polynomial, t), Set1<Lanes>(-0.339247704f));
+			polynomial = Add(Mul(polynomial, t), Set1<Lanes>(0.477705926f));
+			polynomial = Add(Mul(polynomial, t), Set1<Lanes>(-0.721162736f));
+			polynomial = Add(Mul(polynomial, t), Set1<Lanes>(1.442693233f));
+
+			return Add(GetExponent(a), Mul(polynomial, t));
+		}
+
+		/**
+		 * \brief 2^a, relative error below 1.8e-7 (polynomial fitted to 2^f over the fraction)
+		 * Clamps to 2^-126 (FLT_MIN) below that and saturates at 2^128
+		 */
+		template<typename Lanes>
+		Lanes FastExp2(Lanes a)
+		{
+			a = Min(Max(a, Set1<Lanes>(-126.f)), Set1<Lanes>(127.99999f));
+
+			const Lanes whole{ Floor(a) };
+			const Lanes fraction{ Sub(a, whole) };
+
+			Lanes polynomial{ Set1<Lanes>(0.001895110f) };
+			polynomial = Add(Mul(polynomial, fraction), Set1<Lanes>(0.008946208f));
+			polynomial = Add(Mul(polynomial, fraction), Set1<Lanes>(0.055863287f));
+			polynomial = Add(Mul(polynomial, fraction), Set1<Lanes>(0.240140766f));
+			polynomial = Add(Mul(polynomial, fraction), Set1<Lanes>(0.693154633f));
+			polynomial = Add(Mul(polynomial, fraction), Set1<Lanes>(0.999999881f));
+
+			return Mul(polynomial, PowerOfTwo(whole));
+		}
+
+		/**
+		 * \brief base^exponent for base >= 0, 0 for a base of 0.
+		 * Relative error stays below 2.1e-6 * exponent + 2e-7 for bases in [1e-6, 1], under 7.1e-5 for exponents up to 70.
+		 * Results under FLT_MIN come out as FLT_MIN, see FastExp2
+		 */
+		template<typename Lanes>
+		Lanes FastPow(Lanes base, Lanes exponent)
+		{
+			const Lanes power{ FastExp2(Mul(exponent, FastLog2(Max(base, Set1<Lanes>(FLT_MIN))))) };
+			return Select(LessEqual(base, Set1<Lanes>(0.f)), Set1<Lanes>(0.f), power);
+		}
+#pragma endregion
+
+#pragma region Vectors
+		//Vector3 with a lane per sample, one register per component
+		template<typename Lanes>
+		struct Vector3Lanes
+		{
+			Lanes x;
+			Lanes y;
+			Lanes z;
+		};
+
+		//Same vector in every lane
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Set3(float x, float y, float z)
+		{
+			return { Set1<Lanes>(x), Set1<Lanes>(y), Set1<Lanes>(z) };
+		}
+
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Load3(const float* pX, const float* pY, const float* pZ)
+		{
+			return { Load<Lanes>(pX), Load<Lanes>(pY), Load<Lanes>(pZ) };
+		}
+
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Add(const Vector3Lanes<Lanes>& a, const Vector3Lanes<Lanes>& b)
+		{
+			return { Add(a.x, b.x), Add(a.y, b.y), Add(a.z, b.z) };
+		}
+
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Sub(const Vector3Lanes<Lanes>& a, const Vector3Lanes<Lanes>& b)
+		{
+			return { Sub(a.x, b.x), Sub(a.y, b.y), Sub(a.z, b.z) };
+		}
+
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Mul(const Vector3Lanes<Lanes>& a, Lanes scale)
+		{
+			return { Mul(a.x, scale), Mul(a.y, scale), Mul(a.z, scale) };
+		}
+
+		template<typename Lanes>
+		Lanes Dot(const Vector3Lanes<Lanes>& a, const Vector3Lanes<Lanes>& b)
+		{
+			return Add(Add(Mul(a.x, b.x), Mul(a.y, b.y)), Mul(a.z, b.z));
+		}
+
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Normalized(const Vector3Lanes<Lanes>& a)
+		{
+			const Lanes length{ Sqrt(Dot(a, a)) };
+			return { Div(a.x, length), Div(a.y, length), Div(a.z, length) };
+		}
+
+		//Same as Vector3::Reflect
+		template<typename Lanes>
+		Vector3Lanes<Lanes> Reflect(const Vector3Lanes<Lanes>& v1, const Vector3Lanes<Lanes>& v2)
+		{
+			return Sub(v1, Mul(v2, Mul(Set1<Lanes>(2.f), Dot(v1, v2))));
+		}
+
+		//ColorRGB with a lane per sample
+		template<typename Lanes>
+		struct ColorRGBLanes
+		{
+			Lanes r;
+			Lanes g;
+			Lanes b;
+		};
+#pragma endregion
+	}
+}
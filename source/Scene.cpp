@@ -7,7 +7,7 @@ namespace dae {
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1,0,0})})
+		m_Materials({ Material_SolidColor({1,0,0}) })
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
@@ -15,119 +15,543 @@ namespace dae {
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
+	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		for(auto& pMaterial : m_Materials)
+		//todo W1
+		//assert(false && "No Implemented Yet!");
+
+		HitRecord temp{};
+
+		// planes are unbounded, they can't be part of the hierarchy
+		for (const Plane& plane : m_PlaneGeometries)
 		{
-			delete pMaterial;
-			pMaterial = nullptr;
+			if (GeometryUtils::HitTest_Plane(plane, ray, temp) && temp.t < closestHit.t)
+				closestHit = temp;
 		}
 
-		m_Materials.clear();
+		Ray traversalRay{ ray };
+		traversalRay.max = std::min(ray.max, closestHit.t);
+
+		GeometryUtils::TraverseBVH(m_TopLevelBVH, traversalRay, false,
+			[&](uint32_t primitiveIndex, Ray& primitiveRay)
+			{
+				const PrimitiveRef& primitive{ m_BoundedPrimitives[primitiveIndex] };
+				bool didHit{ false };
+
+				switch (primitive.type)
+				{
+				case PrimitiveType::Sphere:
+					didHit = GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], primitiveRay, temp);
+					break;
+				case PrimitiveType::Triangle:
+					didHit = GeometryUtils::HitTest_Triangle_Moller(m_TriangleVec[primitive.index], primitiveRay, temp);
+					break;
+				case PrimitiveType::TriangleMesh:
+					temp.t = primitiveRay.max;
+					didHit = GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], primitiveRay, temp, false, m_TraversalMode);
+					break;
+				}
+
+				if (!didHit)
+					return false;
+
+				closestHit = temp;
+				primitiveRay.max = temp.t;
+				return true;
+			});
 	}
 
-	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	void Scene::GetClosestHits(RayPacket& packet, HitRecord closestHits[RayPacket::Size]) const
 	{
-		//todo W1
-		//assert(false && "No Implemented Yet!");
-
 		HitRecord temp{};
 
-		for (const Sphere& sphere : m_SphereGeometries)
+		// planes are unbounded, they can't be part of the hierarchy
+		for (uint32_t lanes{ packet.activeMask }; lanes; lanes &= lanes - 1)
+		{
+			const int lane{ std::countr_zero(lanes) };
+			const Ray ray{ packet.GetRay(lane) };
+
+			for (const Plane& plane : m_PlaneGeometries)
+			{
+				if (GeometryUtils::HitTest_Plane(plane, ray, temp) && temp.t < closestHits[lane].t)
+					closestHits[lane] = temp;
+			}
+
+			packet.max[lane] = std::min(packet.max[lane], closestHits[lane].t);
+		}
+
+		// only the closest primitive per lane is remembered, its hit record is filled in afterwards
+		uint32_t hitPrimitive[RayPacket::Size]{};
+		uint32_t hitTriangle[RayPacket::Size]{};
+		float hitU[RayPacket::Size]{};
+		float hitV[RayPacket::Size]{};
+		uint32_t hitMask{};
+
+		GeometryUtils::TraversePacketBVH(m_TopLevelBVH, packet,
+			[&](uint32_t primitiveIndex, RayPacket& traversalPacket, uint32_t laneMask)
+			{
+				const PrimitiveRef& primitive{ m_BoundedPrimitives[primitiveIndex] };
+				uint32_t primitiveHits{};
+
+				switch (primitive.type)
+				{
+				case PrimitiveType::Sphere:
+					primitiveHits = GeometryUtils::HitTest_SpherePacket(m_SphereGeometries[primitive.index], traversalPacket, laneMask);
+					break;
+				case PrimitiveType::Triangle:
+				{
+					const Triangle& triangle{ m_TriangleVec[primitive.index] };
+					const TriangleRecord record{ triangle.v0, triangle.v1 - triangle.v0, triangle.v2 - triangle.v0, triangle.normal };
+					primitiveHits = GeometryUtils::HitTest_TriangleRecordPacket(record, GeometryUtils::GetCullSign(triangle.cullMode),
+						traversalPacket, laneMask, hitU, hitV);
+					break;
+				}
+				case PrimitiveType::TriangleMesh:
+					primitiveHits = GeometryUtils::HitTest_TriangleMeshPacket(m_TriangleMeshGeometries[primitive.index],
+						traversalPacket, laneMask, hitTriangle, hitU, hitV);
+					break;
+				}
+
+				hitMask |= primitiveHits;
+				for (uint32_t lanes{ primitiveHits }; lanes; lanes &= lanes - 1)
+					hitPrimitive[std::countr_zero(lanes)] = primitiveIndex;
+
+				return primitiveHits != 0;
+			});
+
+		for (uint32_t lanes{ hitMask }; lanes; lanes &= lanes - 1)
 		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
-			if (temp.t > closestHit.t)
-				temp = closestHit;
+			const int lane{ std::countr_zero(lanes) };
+			const PrimitiveRef& primitive{ m_BoundedPrimitives[hitPrimitive[lane]] };
+
+			// repeating the single ray test gives the exact same record, the packet already knows it will hit
+			Ray ray{ packet.GetRay(lane) };
+			ray.max = FLT_MAX;
+
+			switch (primitive.type)
+			{
+			case PrimitiveType::Sphere:
+				GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], ray, closestHits[lane]);
+				break;
+			case PrimitiveType::Triangle:
+				GeometryUtils::HitTest_Triangle_Moller(m_TriangleVec[primitive.index], ray, closestHits[lane]);
+				break;
+			case PrimitiveType::TriangleMesh:
+				GeometryUtils::GetTriangleMeshHit(m_TriangleMeshGeometries[primitive.index], hitTriangle[lane],
+					hitU[lane], hitV[lane], packet.max[lane], closestHits[lane]);
+				break;
+			}
 		}
+	}
 
+	bool Scene::DoesHit(const Ray& ray) const
+	{
+		//todo W3
 		for (const Plane& plane : m_PlaneGeometries)
 		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
-			if (temp.t > closestHit.t)
-				temp = closestHit;
+			if (GeometryUtils::HitTest_Plane(plane, ray))
+				return true;
 		}
 
-		for (const Triangle& triangle : m_TriangleVec)
+		Ray traversalRay{ ray };
+
+		return GeometryUtils::TraverseBVH(m_TopLevelBVH, traversalRay, true,
+			[&](uint32_t primitiveIndex, const Ray& primitiveRay)
+			{
+				const PrimitiveRef& primitive{ m_BoundedPrimitives[primitiveIndex] };
+
+				switch (primitive.type)
+				{
+				case PrimitiveType::Sphere:
+					return GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], primitiveRay);
+				case PrimitiveType::Triangle:
+					return GeometryUtils::HitTest_Triangle(m_TriangleVec[primitive.index], primitiveRay);
+				case PrimitiveType::TriangleMesh:
+					return GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], primitiveRay, m_TraversalMode);
+				}
+
+				return false;
+			});
+	}
+
+	bool Scene::IsOccluded(const Ray& ray, uint32_t lightIndex) const
+	{
+		// neighbouring pixels are mostly shadowed by the same object, try that one before walking the scene
+		Occluder& lastOccluder{ GetOccluderCache(lightIndex + 1)[lightIndex] };
+		if (HitTest_Occluder(lastOccluder, ray))
+			return true;
+
+		for (uint32_t index{}; index < m_PlaneGeometries.size(); ++index)
 		{
-			GeometryUtils::HitTest_Triangle_Moller(triangle, ray, closestHit);
-			if (temp.t > closestHit.t)
-				temp = closestHit;
+			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[index], ray))
+			{
+				lastOccluder = { Occluder::Type::Plane, index };
+				return true;
+			}
 		}
 
-		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		// the traversal visits nearer nodes first and stops at the first hit
+		// lit pixels forget the occluder, their neighbours are most likely lit as well
+		Ray traversalRay{ ray };
+		lastOccluder = {};
+
+		return GeometryUtils::TraverseBVH(m_TopLevelBVH, traversalRay, true,
+			[&](uint32_t primitiveIndex, const Ray& primitiveRay)
+			{
+				const PrimitiveRef& primitive{ m_BoundedPrimitives[primitiveIndex] };
+				uint32_t triangleIndex{};
+				bool didHit{ false };
+
+				switch (primitive.type)
+				{
+				case PrimitiveType::Sphere:
+					didHit = GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], primitiveRay);
+					break;
+				case PrimitiveType::Triangle:
+					didHit = GeometryUtils::HitTest_Triangle(m_TriangleVec[primitive.index], primitiveRay);
+					break;
+				case PrimitiveType::TriangleMesh:
+					didHit = GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], primitiveRay, m_TraversalMode, &triangleIndex);
+					break;
+				}
+
+				if (didHit)
+					lastOccluder = { Occluder::Type::Primitive, primitiveIndex, triangleIndex };
+
+				return didHit;
+			});
+	}
+
+	uint32_t Scene::GetOcclusionMask(RayPacket& shadowRays, const uint32_t lightIndices[RayPacket::Size]) const
+	{
+		uint32_t lightCount{};
+		for (uint32_t lanes{ shadowRays.activeMask }; lanes; lanes &= lanes - 1)
+			lightCount = std::max(lightCount, lightIndices[std::countr_zero(lanes)] + 1);
+
+		std::vector<Occluder>& lastOccluders{ GetOccluderCache(lightCount) };
+		uint32_t occludedMask{};
+
+		// cached occluders and planes are cheap enough to test lane by lane
+		for (uint32_t lanes{ shadowRays.activeMask }; lanes; lanes &= lanes - 1)
 		{
-			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, closestHit);
-			if (temp.t > closestHit.t)
-				temp = closestHit;
+			const int lane{ std::countr_zero(lanes) };
+			const Ray ray{ shadowRays.GetRay(lane) };
+			Occluder& lastOccluder{ lastOccluders[lightIndices[lane]] };
+
+			if (HitTest_Occluder(lastOccluder, ray))
+			{
+				occludedMask |= 1u << lane;
+				continue;
+			}
+
+			lastOccluder = {};
+
+			for (uint32_t index{}; index < m_PlaneGeometries.size(); ++index)
+			{
+				if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[index], ray))
+				{
+					lastOccluder = { Occluder::Type::Plane, index };
+					occludedMask |= 1u << lane;
+					break;
+				}
+			}
 		}
 
-		closestHit = temp;
+		// the remaining lanes walk the hierarchy together, each one drops out at its first hit
+		shadowRays.activeMask &= ~occludedMask;
+
+		uint32_t hitTriangle[RayPacket::Size]{};
+		float hitU[RayPacket::Size]{};
+		float hitV[RayPacket::Size]{};
+
+		GeometryUtils::TraversePacketBVH(m_TopLevelBVH, shadowRays,
+			[&](uint32_t primitiveIndex, RayPacket& traversalPacket, uint32_t laneMask)
+			{
+				const PrimitiveRef& primitive{ m_BoundedPrimitives[primitiveIndex] };
+				uint32_t primitiveHits{};
+
+				switch (primitive.type)
+				{
+				case PrimitiveType::Sphere:
+					primitiveHits = GeometryUtils::HitTest_SpherePacket(m_SphereGeometries[primitive.index], traversalPacket, laneMask);
+					break;
+				case PrimitiveType::Triangle:
+				{
+					const Triangle& triangle{ m_TriangleVec[primitive.index] };
+					const TriangleRecord record{ triangle.v0, triangle.v1 - triangle.v0, triangle.v2 - triangle.v0, triangle.normal };
+					primitiveHits = GeometryUtils::HitTest_TriangleRecordPacket(record, GeometryUtils::GetCullSign(triangle.cullMode, true),
+						traversalPacket, laneMask, hitU, hitV);
+					break;
+				}
+				case PrimitiveType::TriangleMesh:
+					primitiveHits = GeometryUtils::HitTest_TriangleMeshPacket(m_TriangleMeshGeometries[primitive.index],
+						traversalPacket, laneMask, hitTriangle, hitU, hitV, true);
+					break;
+				}
+
+				for (uint32_t lanes{ primitiveHits }; lanes; lanes &= lanes - 1)
+				{
+					const int lane{ std::countr_zero(lanes) };
+					lastOccluders[lightIndices[lane]] = { Occluder::Type::Primitive, primitiveIndex, hitTriangle[lane] };
+				}
+
+				traversalPacket.activeMask &= ~primitiveHits;
+				occludedMask |= primitiveHits;
+				return primitiveHits != 0;
+			});
+
+		return occludedMask;
 	}
 
-	bool Scene::DoesHit(const Ray& ray) const
+	std::vector<Scene::Occluder>& Scene::GetOccluderCache(uint32_t lightCount) const
 	{
-		//todo W3
-		for (const Sphere& sphere : m_SphereGeometries)
+		thread_local const Scene* pCacheOwner{};
+		thread_local std::vector<Occluder> lastOccluders{};
+
+		if (pCacheOwner != this)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphere, ray))
-				return true;
+			pCacheOwner = this;
+			lastOccluders.clear();
 		}
 
-		for (const Plane& plane : m_PlaneGeometries)
+		if (lightCount > lastOccluders.size())
+			lastOccluders.resize(lightCount);
+
+		return lastOccluders;
+	}
+
+	bool Scene::HitTest_Occluder(const Occluder& occluder, const Ray& ray) const
+	{
+		// the cache may point at anything the scene held before, only test what still exists
+		switch (occluder.type)
 		{
-			if (GeometryUtils::HitTest_Plane(plane, ray))
-				return true;
+		case Occluder::Type::Plane:
+			return occluder.index < m_PlaneGeometries.size() && GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder.index], ray);
+		case Occluder::Type::Primitive:
+		{
+			if (occluder.index >= m_BoundedPrimitives.size())
+				return false;
+
+			const PrimitiveRef& primitive{ m_BoundedPrimitives[occluder.index] };
+
+			switch (primitive.type)
+			{
+			case PrimitiveType::Sphere:
+				return GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], ray);
+			case PrimitiveType::Triangle:
+				return GeometryUtils::HitTest_Triangle(m_TriangleVec[primitive.index], ray);
+			case PrimitiveType::TriangleMesh:
+				return GeometryUtils::HitTest_MeshTriangle(m_TriangleMeshGeometries[primitive.index], occluder.triangleIndex, ray);
+			}
+			break;
 		}
+		case Occluder::Type::None:
+			break;
+		}
+
+		return false;
+	}
 
-		for (const Triangle& triangle : m_TriangleVec)
+	void Scene::UpdateAccelerationStructure()
+	{
+		// only the objects hanging from a node that moved get placed again
+		m_MovedSpheres.clear();
+		bool lightsMoved{ false };
+
+		for (const uint32_t node : m_SceneGraph.UpdateWorldTransforms())
 		{
-			if (GeometryUtils::HitTest_Triangle(triangle, ray))
-				return true;
+			const Matrix& worldTransform{ m_SceneGraph.GetWorldTransform(node) };
+
+			for (const Attachment& attachment : m_SceneGraph.GetAttachments(node))
+			{
+				switch (attachment.type)
+				{
+				case AttachmentType::Sphere:
+					m_SphereGeometries[attachment.index] = PlaceSphere(m_LocalSpheres[attachment.index], worldTransform);
+					m_MovedSpheres.push_back(attachment.index);
+					break;
+				case AttachmentType::Plane:
+					m_PlaneGeometries[attachment.index] = PlacePlane(m_LocalPlanes[attachment.index], worldTransform);
+					break;
+				case AttachmentType::TriangleMesh:
+					m_TriangleMeshGeometries[attachment.index].SetParentTransform(worldTransform);
+					break;
+				case AttachmentType::Light:
+					m_Lights[attachment.index] = PlaceLight(m_LocalLights[attachment.index], worldTransform);
+					lightsMoved = true;
+					break;
+				}
+			}
 		}
 
-		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		// meshes whose transform and geometry didn't change skip this
+		for (TriangleMesh& mesh : m_TriangleMeshGeometries)
+			mesh.UpdateTransforms();
+
+		// a sphere added along with one mesh less keeps the total, every kind has to be counted on its own
+		const size_t primitiveCount{ m_SphereGeometries.size() + m_TriangleVec.size() + m_TriangleMeshGeometries.size() };
+		const bool isNewLayout{ m_LayoutSphereCount != m_SphereGeometries.size() || m_LayoutTriangleCount != m_TriangleVec.size() ||
+			m_LayoutMeshCount != m_TriangleMeshGeometries.size() || m_PrimitiveBounds.size() != primitiveCount };
+		bool boundsChanged{ isNewLayout };
+
+		const auto updateBounds{
+			[&](uint32_t primitiveIndex, const AABB& bounds)
+			{
+				AABB& fittedBounds{ m_PrimitiveBounds[primitiveIndex] };
+				if (fittedBounds == bounds)
+					return;
+
+				fittedBounds = bounds;
+				boundsChanged = true;
+			} };
+
+		const auto getSphereBounds{
+			[](const Sphere& sphere)
+			{
+				const Vector3 radius{ sphere.radius, sphere.radius, sphere.radius };
+				return AABB{ sphere.origin - radius, sphere.origin + radius };
+			} };
+
+		// spheres come first, then the loose triangles and then the meshes
+		const uint32_t firstTriangle{ static_cast<uint32_t>(m_SphereGeometries.size()) };
+		const uint32_t firstMesh{ firstTriangle + static_cast<uint32_t>(m_TriangleVec.size()) };
+
+		if (isNewLayout)
 		{
-			if (GeometryUtils::HitTest_TriangleMesh(mesh, ray))
-				return true;
+			m_BoundedPrimitives.clear();
+			m_BoundedPrimitives.reserve(primitiveCount);
+
+			for (uint32_t index{}; index < m_SphereGeometries.size(); ++index)
+				m_BoundedPrimitives.push_back({ PrimitiveType::Sphere, index });
+			for (uint32_t index{}; index < m_TriangleVec.size(); ++index)
+				m_BoundedPrimitives.push_back({ PrimitiveType::Triangle, index });
+			for (uint32_t index{}; index < m_TriangleMeshGeometries.size(); ++index)
+				m_BoundedPrimitives.push_back({ PrimitiveType::TriangleMesh, index });
+
+			m_PrimitiveBounds.assign(primitiveCount, AABB{});
+			m_MeshWorldVersions.assign(m_TriangleMeshGeometries.size(), 0);
+
+			m_LayoutSphereCount = m_SphereGeometries.size();
+			m_LayoutTriangleCount = m_TriangleVec.size();
+			m_LayoutMeshCount = m_TriangleMeshGeometries.size();
+
+			for (uint32_t index{}; index < m_SphereGeometries.size(); ++index)
+				updateBounds(index, getSphereBounds(m_SphereGeometries[index]));
+
+			// loose triangles aren't part of the scene graph, they never move
+			for (uint32_t index{}; index < m_TriangleVec.size(); ++index)
+			{
+				const Triangle& triangle{ m_TriangleVec[index] };
+
+				AABB bounds{};
+				bounds.Grow(triangle.v0);
+				bounds.Grow(triangle.v1);
+				bounds.Grow(triangle.v2);
+
+				updateBounds(firstTriangle + index, bounds);
+			}
+		}
+		else
+		{
+			for (const uint32_t index : m_MovedSpheres)
+				updateBounds(index, getSphereBounds(m_SphereGeometries[index]));
 		}
 
-		return false;
+		for (uint32_t index{}; index < m_TriangleMeshGeometries.size(); ++index)
+		{
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[index] };
+			if (m_MeshWorldVersions[index] == mesh.worldVersion)
+				continue;
+
+			m_MeshWorldVersions[index] = mesh.worldVersion;
+			updateBounds(firstMesh + index, { mesh.transformedMinAABB, mesh.transformedMaxAABB });
+		}
+
+		// refit while the layout holds up, moving meshes mostly just shift their boxes
+		if (boundsChanged)
+			m_TopLevelBVH.Update(m_PrimitiveBounds);
+
+		// a median split over a few thousand points, cheap enough to redo whenever a light moved
+		if (lightsMoved || m_LightBVHLightCount != m_Lights.size())
+		{
+			m_LightBVH.Build(m_Lights);
+			m_LightBVHLightCount = m_Lights.size();
+		}
+	}
+
+	void Scene::CycleTraversalMode()
+	{
+		m_TraversalMode = (m_TraversalMode == BVHTraversalMode::Binary) ? BVHTraversalMode::Wide : BVHTraversalMode::Binary;
+
+		switch (m_TraversalMode)
+		{
+		case BVHTraversalMode::Binary:
+			std::cout << "Binary BVH\n";
+			break;
+		case BVHTraversalMode::Wide:
+			std::cout << "Wide BVH\n";
+			break;
+		}
+	}
+
+	void Scene::CompactMeshes()
+	{
+		// shared geometry is only compacted once, the instances pick the new version up on their next update
+		for (TriangleMesh& mesh : m_TriangleMeshGeometries)
+			mesh.pGeometry->Compact();
+
+		std::cout << "Compact meshes\n";
 	}
 
 #pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	const Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex, uint32_t node)
 	{
 		Sphere s;
 		s.origin = origin;
 		s.radius = radius;
 		s.materialIndex = materialIndex;
 
-		m_SphereGeometries.emplace_back(s);
+		m_SceneGraph.Attach(node, { AttachmentType::Sphere, static_cast<uint32_t>(m_SphereGeometries.size()) });
+		m_LocalSpheres.push_back(s);
+
+		m_SphereGeometries.emplace_back(PlaceSphere(s, m_SceneGraph.GetWorldTransform(node)));
 		return &m_SphereGeometries.back();
 	}
 
-	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
+	const Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex, uint32_t node)
 	{
 		Plane p;
 		p.origin = origin;
 		p.normal = normal;
 		p.materialIndex = materialIndex;
 
-		m_PlaneGeometries.emplace_back(p);
+		m_SceneGraph.Attach(node, { AttachmentType::Plane, static_cast<uint32_t>(m_PlaneGeometries.size()) });
+		m_LocalPlanes.push_back(p);
+
+		m_PlaneGeometries.emplace_back(PlacePlane(p, m_SceneGraph.GetWorldTransform(node)));
 		return &m_PlaneGeometries.back();
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex, uint32_t node)
+	{
+		return AddTriangleMesh(std::make_shared<MeshGeometry>(), cullMode, materialIndex, node);
+	}
+
+	TriangleMesh* Scene::AddTriangleMesh(const std::shared_ptr<MeshGeometry>& pGeometry, TriangleCullMode cullMode, unsigned char materialIndex, uint32_t node)
 	{
 		TriangleMesh m{};
+		m.pGeometry = pGeometry;
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
+		m.SetParentTransform(m_SceneGraph.GetWorldTransform(node));
 
-		m_TriangleMeshGeometries.emplace_back(m);
+		m_SceneGraph.Attach(node, { AttachmentType::TriangleMesh, static_cast<uint32_t>(m_TriangleMeshGeometries.size()) });
+
+		m_TriangleMeshGeometries.emplace_back(std::move(m));
 		return &m_TriangleMeshGeometries.back();
 	}
 
-	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
+	const Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color, uint32_t node)
 	{
 		Light l;
 		l.origin = origin;
@@ -135,11 +559,10 @@ namespace dae {
 		l.color = color;
 		l.type = LightType::Point;
 
-		m_Lights.emplace_back(l);
-		return &m_Lights.back();
+		return AddLight(l, node);
 	}
 
-	Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
+	const Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color, uint32_t node)
 	{
 		Light l;
 		l.direction = direction;
@@ -147,15 +570,50 @@ namespace dae {
 		l.color = color;
 		l.type = LightType::Directional;
 
-		m_Lights.emplace_back(l);
+		return AddLight(l, node);
+	}
+
+	const Light* Scene::AddLight(const Light& light, uint32_t node)
+	{
+		m_SceneGraph.Attach(node, { AttachmentType::Light, static_cast<uint32_t>(m_Lights.size()) });
+		m_LocalLights.push_back(light);
+
+		m_Lights.emplace_back(PlaceLight(light, m_SceneGraph.GetWorldTransform(node)));
 		return &m_Lights.back();
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
+	unsigned char Scene::AddMaterial(const Material& material)
 	{
-		m_Materials.push_back(pMaterial);
+		m_Materials.push_back(material);
 		return static_cast<unsigned char>(m_Materials.size() - 1);
 	}
+
+	Sphere Scene::PlaceSphere(const Sphere& sphere, const Matrix& transform)
+	{
+		Sphere placed{ sphere };
+		placed.origin = transform.TransformPoint(sphere.origin);
+		placed.radius = sphere.radius * transform.GetAxisX().Magnitude();
+
+		return placed;
+	}
+
+	Plane Scene::PlacePlane(const Plane& plane, const Matrix& transform)
+	{
+		Plane placed{ plane };
+		placed.origin = transform.TransformPoint(plane.origin);
+		placed.normal = transform.GetRotation().TransformVector(plane.normal);
+
+		return placed;
+	}
+
+	Light Scene::PlaceLight(const Light& light, const Matrix& transform)
+	{
+		Light placed{ light };
+		placed.origin = transform.TransformPoint(light.origin);
+		placed.direction = transform.GetRotation().TransformVector(light.direction);
+
+		return placed;
+	}
 #pragma endregion
 #pragma endregion
 
@@ -164,11 +622,11 @@ namespace dae {
 	{
 				//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material_SolidColor{ colors::Blue });
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material_SolidColor{ colors::Yellow });
+		const unsigned char matId_Solid_Green = AddMaterial(Material_SolidColor{ colors::Green });
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material_SolidColor{ colors::Magenta });
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -214,10 +672,10 @@ namespace dae {
 
 		// Default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor(colors::Blue));
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor(colors::Yellow));
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor(colors::Green));
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor(colors::Magenta));
+		const unsigned char matId_Solid_Blue = AddMaterial(Material_SolidColor(colors::Blue));
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material_SolidColor(colors::Yellow));
+		const unsigned char matId_Solid_Green = AddMaterial(Material_SolidColor(colors::Green));
+		const unsigned char matId_Solid_Magenta = AddMaterial(Material_SolidColor(colors::Magenta));
 
 		// Plane
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matId_Solid_Green);
@@ -251,15 +709,15 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -287,8 +745,8 @@ namespace dae {
 
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_LambertPhong{ colors::Blue, 1.f, 1.f, 60.f });
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_Lambert{ colors::Yellow, 0.8f });
+		const unsigned char matId_Solid_Blue = AddMaterial(Material_LambertPhong{ colors::Blue, 1.f, 1.f, 60.f });
+		const unsigned char matId_Solid_Yellow = AddMaterial(Material_Lambert{ colors::Yellow, 0.8f });
 
 		//Spheres
 		AddSphere({ -.75f, 1.f, .0f }, 1.f, matId_Solid_Red);
@@ -307,11 +765,11 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 		m_Camera.forward = { 0.266f, -0.453f, 0.86f };
 
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
 
 		// Plane
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue);
@@ -320,9 +778,9 @@ namespace dae {
 		AddPlane({ 0.f, 10.f, 0.f }, { 0.f, -1.f, 0.f }, matLambert_GrayBlue);
 		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);
 
-		const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
-		const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
-		const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
+		const auto matLambertPhong1 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
+		const auto matLambertPhong2 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
+		const auto matLambertPhong3 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
 
 		AddSphere(Vector3{ -1.75f, 1.f, 0.f }, .75f, matLambertPhong1);
 		AddSphere(Vector3{ 0.f, 1.f, 0.f }, .75f, matLambertPhong2);
@@ -342,8 +800,8 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
@@ -386,18 +844,18 @@ namespace dae {
 		//Triangle Mesh
 		//=============
 		m_MeshPtr = AddTriangleMesh(TriangleCullMode::NoCulling, materialIndex);
-		m_MeshPtr->positions = {
+		m_MeshPtr->pGeometry->positions = {
 			{-.75f,-1.f,.0f},  //V0
 			{-.75f,1.f, .0f},  //V2
 			{.75f,1.f,1.f},    //V3
 			{.75f,-1.f,0.f} }; //V4
 
-		m_MeshPtr->indices = {
+		m_MeshPtr->pGeometry->indices = {
 			0,1,2, //Triangle 1
 			0,2,3  //Triangle 2
 		};
 
-		m_MeshPtr->CalculateNormals();
+		m_MeshPtr->pGeometry->CalculateNormals();
 
 		m_MeshPtr->Translate({ 0.f,1.5f,0.f });
 		m_MeshPtr->RotateY(90);
@@ -411,9 +869,9 @@ namespace dae {
 		m_MeshPtr = AddTriangleMesh(TriangleCullMode::NoCulling, materialIndex);
 		Utils::ParseOBJ("Resources/simple_cube.obj",
 			//Utils::ParseOBJ("Resources/simple_object.obj",
-			m_MeshPtr->positions,
-			m_MeshPtr->normals,
-			m_MeshPtr->indices);
+			m_MeshPtr->pGeometry->positions,
+			m_MeshPtr->pGeometry->normals,
+			m_MeshPtr->pGeometry->indices);
 
 		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
 
@@ -421,6 +879,7 @@ namespace dae {
 		m_MeshPtr->Translate({ 0,1.f,0.f });
 
 		m_MeshPtr->UpdateTransforms();
+		m_MeshPtr->pGeometry->bvh.PrintStats("simple_cube");
 	}
 
 	void Scene_W4_ReferenceScene::Initialize()
@@ -429,15 +888,15 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -455,20 +914,21 @@ namespace dae {
 		//CW Winding Order!
 		const Triangle baseTriangle = { Vector3(-.75f, 1.5f, 0.f), Vector3(.75f, 0.f, 0.f), Vector3(-.75f, 0.f, 0.f) };
 
+		//One geometry, three placements
+		const auto pTriangleGeometry{ std::make_shared<MeshGeometry>() };
+		pTriangleGeometry->AppendTriangle(baseTriangle);
+
 		m_MeshPtrVec.resize(3);
 
-		m_MeshPtrVec[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_MeshPtrVec[0]->AppendTriangle(baseTriangle, true);
+		m_MeshPtrVec[0] = AddTriangleMesh(pTriangleGeometry, TriangleCullMode::BackFaceCulling, matLambert_White);
 		m_MeshPtrVec[0]->Translate({ -1.75f,4.5f,0.f });
 		m_MeshPtrVec[0]->UpdateTransforms();
 
-		m_MeshPtrVec[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_MeshPtrVec[1]->AppendTriangle(baseTriangle, true);
+		m_MeshPtrVec[1] = AddTriangleMesh(pTriangleGeometry, TriangleCullMode::FrontFaceCulling, matLambert_White);
 		m_MeshPtrVec[1]->Translate({ 0.f,4.5f,0.f });
 		m_MeshPtrVec[1]->UpdateTransforms();
 
-		m_MeshPtrVec[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_MeshPtrVec[2]->AppendTriangle(baseTriangle, true);
+		m_MeshPtrVec[2] = AddTriangleMesh(pTriangleGeometry, TriangleCullMode::NoCulling, matLambert_White);
 		m_MeshPtrVec[2]->Translate({ 1.75f,4.5f,0.f });
 		m_MeshPtrVec[2]->UpdateTransforms();
 
@@ -481,12 +941,10 @@ namespace dae {
 	{
 		Scene::Update(pTimer);
 
+		// only dirties the meshes, UpdateAccelerationStructure recalculates the ones that actually turned
 		for (TriangleMesh* meshPtr : m_MeshPtrVec)
-		{
 			meshPtr->RotateY(PI_DIV_2 * pTimer->GetTotal());
-			meshPtr->UpdateTransforms();
-		}
-		
+
 	}
 
 	void Scene_W4_BunnyScene::Initialize()
@@ -495,8 +953,8 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -510,9 +968,9 @@ namespace dae {
 		m_MeshPtr = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
 		Utils::ParseOBJ("Resources/lowpoly_bunny.obj",
 			//Utils::ParseOBJ("Resources/simple_object.obj",
-			m_MeshPtr->positions,
-			m_MeshPtr->normals,
-			m_MeshPtr->indices);
+			m_MeshPtr->pGeometry->positions,
+			m_MeshPtr->pGeometry->normals,
+			m_MeshPtr->pGeometry->indices);
 
 		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
 
@@ -520,6 +978,7 @@ namespace dae {
 		m_MeshPtr->Scale({ 2,2,2 });
 
 		m_MeshPtr->UpdateTransforms();
+		m_MeshPtr->pGeometry->bvh.PrintStats("lowpoly_bunny");
 
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Backlight
 		AddPointLight(Vector3{ -2.5f, 5.f, -5.f }, 70.f, ColorRGB{ 1.f, .8f, .45f }); //Front Light Left
@@ -531,7 +990,51 @@ namespace dae {
 		Scene::Update(pTimer);
 
 		m_MeshPtr->RotateY(PI_DIV_2 * pTimer->GetTotal());
-		m_MeshPtr->UpdateTransforms();
+	}
+
+	void Scene_W4_ManyLightsScene::Initialize()
+	{
+		sceneName = "Many Lights Scene";
+		m_Camera.origin = { 0,3,-9 };
+		m_Camera.fovAngle = 45.f;
+
+		const auto matCT_GrayMediumMetal = AddMaterial(Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+
+		//Long hall, most lights are too far away from a given point to light it
+		AddPlane(Vector3{ 0.f, 0.f, 60.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+		AddPlane(Vector3{ 0.f, 6.f, 0.f }, Vector3{ 0.f, -1.f, 0.f }, matLambert_GrayBlue); //TOP
+		AddPlane(Vector3{ 5.f, 0.f, 0.f }, Vector3{ -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
+		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
+
+		for (int index{}; index < 8; ++index)
+		{
+			const float z{ index * 6.f };
+			AddSphere(Vector3{ -2.5f, 1.f, z }, .75f, matCT_GrayMediumMetal);
+			AddSphere(Vector3{ 2.5f, 1.f, z + 3.f }, .75f, matCT_GrayMediumPlastic);
+		}
+
+		//Rows of small colored lights along the walls and the ceiling
+		constexpr int rowCount{ 12 };
+		constexpr int lightsPerRow{ 192 };
+		for (int row{}; row < rowCount; ++row)
+		{
+			for (int column{}; column < lightsPerRow; ++column)
+			{
+				const float u{ (column + .5f) / lightsPerRow };
+				const float v{ (row + .5f) / rowCount };
+
+				// four rows per wall, four on the ceiling
+				const Vector3 position{
+					row < 4 ? -4.9f : row < 8 ? 4.9f : Lerpf(-3.f, 3.f, (row - 8) / 3.f),
+					row < 8 ? 1.5f + (row % 4) : 5.9f,
+					Lerpf(-8.f, 59.f, u) };
+
+				AddPointLight(position, .3f, ColorRGB{ u, 1.f - u, v });
+			}
+		}
 	}
 #pragma endregion
 }
@@ -5,12 +5,14 @@
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "LightBVH.h"
+#include "Material.h"
+#include "SceneGraph.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
@@ -20,7 +22,7 @@ namespace dae
 	{
 	public:
 		Scene();
-		virtual ~Scene();
+		virtual ~Scene() = default;
 
 		Scene(const Scene&) = delete;
 		Scene(Scene&&) noexcept = delete;
@@ -35,12 +37,28 @@ namespace dae
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		//Same result as GetClosestHit for every active lane, the packet is traced through the hierarchy as a whole
+		void GetClosestHits(RayPacket& packet, HitRecord closestHits[RayPacket::Size]) const;
 		bool DoesHit(const Ray& ray) const;
+		//DoesHit for the shadow ray towards light lightIndex, the object that blocked that light last time on this thread is tested first
+		bool IsOccluded(const Ray& ray, uint32_t lightIndex) const;
+		//IsOccluded for a batch of shadow rays leaving the same point, lane i goes to light lightIndices[i]
+		//All of them are traced together, returns a bit per occluded lane
+		uint32_t GetOcclusionMask(RayPacket& shadowRays, const uint32_t lightIndices[RayPacket::Size]) const;
+
+		//Propagates the scene graph, brings dirty meshes up to date and refits the top level and light hierarchies
+		//to whatever moved, call before tracing. Nothing gets touched when nothing moved since the last call
+		void UpdateAccelerationStructure();
+		void CycleTraversalMode();
+		//Swaps every mesh geometry for its quantized form (see MeshGeometry::Compact), call once the meshes are filled in.
+		//There's no way back, calling it again does nothing
+		void CompactMeshes();
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+		const LightBVH& GetLightBVH() const { return m_LightBVH; }
+		const std::vector<Material>& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
@@ -51,17 +69,91 @@ namespace dae
 
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		std::vector<Material> m_Materials{};
+
+		//Spheres, planes, meshes and lights hang from its nodes, the vectors above hold them placed in the world
+		//Move them through their node, the world copies get rewritten whenever it moves
+		SceneGraph m_SceneGraph{};
+
+		//Spheres, planes and lights as they were added, relative to their node and indexed like the world ones
+		std::vector<Sphere> m_LocalSpheres{};
+		std::vector<Plane> m_LocalPlanes{};
+		std::vector<Light> m_LocalLights{};
 
 		Camera m_Camera{};
 
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
-		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		//Top level hierarchy over everything with finite bounds, planes are tested separately
+		enum class PrimitiveType : uint8_t
+		{
+			Sphere,
+			Triangle,
+			TriangleMesh
+		};
+
+		struct PrimitiveRef
+		{
+			PrimitiveType type{};
+			uint32_t index{};
+		};
+
+		std::vector<PrimitiveRef> m_BoundedPrimitives{};
+		BVH m_TopLevelBVH{};
+
+		//What the top level hierarchy was last fitted to, indexed like m_BoundedPrimitives
+		//Spheres are only looked at again when their node moved, meshes when their worldVersion moved on
+		std::vector<AABB> m_PrimitiveBounds{};
+		std::vector<uint32_t> m_MeshWorldVersions{};
+		std::vector<uint32_t> m_MovedSpheres{};
+		//How many of every kind m_BoundedPrimitives was laid out for
+		size_t m_LayoutSphereCount{};
+		size_t m_LayoutTriangleCount{};
+		size_t m_LayoutMeshCount{};
+
+		//Hierarchy over the point lights, rebuilt with the top level one when a light moved or was added
+		LightBVH m_LightBVH{};
+		size_t m_LightBVHLightCount{};
+
+		//Layout used for the mesh hierarchies
+		BVHTraversalMode m_TraversalMode{ BVHTraversalMode::Binary };
+
+		//Object that blocked a shadow ray, triangleIndex is only used for meshes
+		struct Occluder
+		{
+			enum class Type : uint8_t
+			{
+				None,
+				Plane,
+				Primitive
+			};
+
+			Type type{ Type::None };
+			uint32_t index{};
+			uint32_t triangleIndex{};
+		};
+
+		//Last occluder per light of the calling thread
+		std::vector<Occluder>& GetOccluderCache(uint32_t lightCount) const;
+		bool HitTest_Occluder(const Occluder& occluder, const Ray& ray) const;
+
+		//Positions and directions are relative to node. The returned objects are the world copies, which get rewritten from the
+		//local ones whenever the node moves, so they are read-only: move them through their node instead
+		const Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0, uint32_t node = SceneGraph::Root);
+		const Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0, uint32_t node = SceneGraph::Root);
+		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0, uint32_t node = SceneGraph::Root);
+		TriangleMesh* AddTriangleMesh(const std::shared_ptr<MeshGeometry>& pGeometry, TriangleCullMode cullMode, unsigned char materialIndex = 0, uint32_t node = SceneGraph::Root);
+
+		const Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color, uint32_t node = SceneGraph::Root);
+		const Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color, uint32_t node = SceneGraph::Root);
+		unsigned char AddMaterial(const Material& material);
+
+	private:
+		//Object relative to a node placed with the world transform of that node
+		//Spheres only stay spheres under a uniform scale, their radius follows the x axis
+		static Sphere PlaceSphere(const Sphere& sphere, const Matrix& transform);
+		static Plane PlacePlane(const Plane& plane, const Matrix& transform);
+		static Light PlaceLight(const Light& light, const Matrix& transform);
 
-		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
-		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		const Light* AddLight(const Light& light, uint32_t node);
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -183,4 +275,20 @@ namespace dae
 	private:
 		TriangleMesh* m_MeshPtr{ nullptr };
 	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//WEEK 4 Many Lights Scene
+	class Scene_W4_ManyLightsScene final : public Scene
+	{
+	public:
+		Scene_W4_ManyLightsScene() = default;
+		~Scene_W4_ManyLightsScene() override = default;
+
+		Scene_W4_ManyLightsScene(const Scene_W4_ManyLightsScene&) = delete;
+		Scene_W4_ManyLightsScene(Scene_W4_ManyLightsScene&&) noexcept = delete;
+		Scene_W4_ManyLightsScene& operator=(const Scene_W4_ManyLightsScene&) = delete;
+		Scene_W4_ManyLightsScene& operator=(Scene_W4_ManyLightsScene&&) noexcept = delete;
+
+		void Initialize() override;
+	};
 }
@@ -0,0 +1,114 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <execution>
+
+namespace dae
+{
+	SceneGraph::SceneGraph()
+	{
+		// identity root, everything added without a parent hangs from it
+		m_Nodes.emplace_back();
+	}
+
+	uint32_t SceneGraph::AddNode(const Matrix& localTransform, uint32_t parent)
+	{
+		assert(parent < m_Nodes.size());
+
+		const uint32_t nodeIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+
+		Node& node{ m_Nodes.emplace_back() };
+		node.localTransform = localTransform;
+		node.worldTransform = localTransform * m_Nodes[parent].worldTransform;
+		node.parent = parent;
+
+		m_Nodes[parent].children.push_back(nodeIndex);
+		for (uint32_t ancestor{ parent }; ancestor != InvalidNode; ancestor = m_Nodes[ancestor].parent)
+			++m_Nodes[ancestor].subtreeSize;
+
+		return nodeIndex;
+	}
+
+	void SceneGraph::Attach(uint32_t node, const Attachment& attachment)
+	{
+		m_Nodes[node].attachments.push_back(attachment);
+	}
+
+	void SceneGraph::SetLocalTransform(uint32_t nodeIndex, const Matrix& localTransform)
+	{
+		Node& node{ m_Nodes[nodeIndex] };
+
+		//Animations set the same value every frame while paused, that shouldn't move anything
+		if (node.localTransform == localTransform)
+			return;
+
+		node.localTransform = localTransform;
+		if (node.isMarked)
+			return;
+
+		node.isMarked = true;
+		m_MarkedNodes.push_back(nodeIndex);
+	}
+
+	const std::vector<uint32_t>& SceneGraph::UpdateWorldTransforms()
+	{
+		m_UpdatedNodes.clear();
+
+		// a marked node below another marked one gets updated with the subtree of that one
+		// all of them have to be checked before the first update clears the marks
+		std::erase_if(m_MarkedNodes, [this](uint32_t nodeIndex) { return HasMarkedAncestor(nodeIndex); });
+
+		for (const uint32_t nodeIndex : m_MarkedNodes)
+			UpdateSubtree(nodeIndex, m_UpdatedNodes);
+
+		m_MarkedNodes.clear();
+		return m_UpdatedNodes;
+	}
+
+	void SceneGraph::UpdateSubtree(uint32_t nodeIndex, std::vector<uint32_t>& updatedNodes)
+	{
+		Node& node{ m_Nodes[nodeIndex] };
+
+		node.worldTransform = node.parent == InvalidNode ? node.localTransform : node.localTransform * m_Nodes[node.parent].worldTransform;
+		node.isMarked = false;
+		updatedNodes.push_back(nodeIndex);
+
+		if (node.subtreeSize < ParallelUpdateThreshold || node.children.size() < 2)
+		{
+			for (const uint32_t childIndex : node.children)
+				UpdateSubtree(childIndex, updatedNodes);
+			return;
+		}
+
+		// the child subtrees only read this node, every task takes a run of children and collects its own updated nodes
+		// joining them in task order keeps every parent ahead of its children
+		const uint32_t childCount{ static_cast<uint32_t>(node.children.size()) };
+		const uint32_t taskCount{ std::min(childCount, UpdateTaskCount) };
+
+		std::vector<std::vector<uint32_t>> taskUpdatedNodes(taskCount);
+		std::for_each(std::execution::par, taskUpdatedNodes.begin(), taskUpdatedNodes.end(),
+			[&](std::vector<uint32_t>& taskNodes)
+			{
+				const uint32_t task{ static_cast<uint32_t>(&taskNodes - taskUpdatedNodes.data()) };
+				const uint32_t lastChild{ (task + 1) * childCount / taskCount };
+
+				for (uint32_t child{ task * childCount / taskCount }; child < lastChild; ++child)
+					UpdateSubtree(node.children[child], taskNodes);
+			});
+
+		for (const std::vector<uint32_t>& taskNodes : taskUpdatedNodes)
+			updatedNodes.insert(updatedNodes.end(), taskNodes.begin(), taskNodes.end());
+	}
+
+	bool SceneGraph::HasMarkedAncestor(uint32_t nodeIndex) const
+	{
+		for (uint32_t ancestor{ m_Nodes[nodeIndex].parent }; ancestor != InvalidNode; ancestor = m_Nodes[ancestor].parent)
+		{
+			if (m_Nodes[ancestor].isMarked)
+				return true;
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Object hanging from a scene graph node, index points into the scene vector of its type
+	enum class AttachmentType : uint8_t
+	{
+		Sphere,
+		Plane,
+		TriangleMesh,
+		Light
+	};
+
+	struct Attachment
+	{
+		AttachmentType type{};
+		uint32_t index{};
+	};
+
+	/**
+	 * \brief Hierarchy of transforms the objects of a scene hang from.
+	 * Every node stores its transform relative to its parent and caches its world transform. Changing a node only marks it,
+	 * UpdateWorldTransforms then recalculates the subtrees below the marked nodes and leaves the rest of the tree alone
+	 */
+	class SceneGraph final
+	{
+	public:
+		static constexpr uint32_t Root{ 0 };
+		static constexpr uint32_t InvalidNode{ UINT32_MAX };
+
+		// Subtrees of fewer nodes are updated on the calling thread, bigger ones split their children over tasks
+		static constexpr uint32_t ParallelUpdateThreshold{ 4096 };
+		static constexpr uint32_t UpdateTaskCount{ 64 };
+
+		SceneGraph();
+
+		//The world transform of the new node is ready right away, unless one of its ancestors is marked
+		uint32_t AddNode(const Matrix& localTransform, uint32_t parent = Root);
+		void Attach(uint32_t node, const Attachment& attachment);
+
+		//Only marks the node, and only when the transform actually changed
+		void SetLocalTransform(uint32_t node, const Matrix& localTransform);
+
+		uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+		uint32_t GetParent(uint32_t node) const { return m_Nodes[node].parent; }
+		const Matrix& GetLocalTransform(uint32_t node) const { return m_Nodes[node].localTransform; }
+		//As of the last UpdateWorldTransforms
+		const Matrix& GetWorldTransform(uint32_t node) const { return m_Nodes[node].worldTransform; }
+		const std::vector<Attachment>& GetAttachments(uint32_t node) const { return m_Nodes[node].attachments; }
+
+		/**
+		 * \brief Recalculates the world transform of every marked node and everything below it
+		 * \return Nodes whose world transform was recalculated, every parent comes before its children.
+		 * Stays valid until the next call
+		 */
+		const std::vector<uint32_t>& UpdateWorldTransforms();
+
+	private:
+		struct Node
+		{
+			Matrix localTransform{};
+			Matrix worldTransform{};
+
+			uint32_t parent{ InvalidNode };
+			// this node and all of its descendants
+			uint32_t subtreeSize{ 1 };
+			// local transform changed since the last UpdateWorldTransforms
+			bool isMarked{};
+
+			std::vector<uint32_t> children{};
+			std::vector<Attachment> attachments{};
+		};
+
+		void UpdateSubtree(uint32_t nodeIndex, std::vector<uint32_t>& updatedNodes);
+		bool HasMarkedAncestor(uint32_t nodeIndex) const;
+
+		std::vector<Node> m_Nodes{};
+		std::vector<uint32_t> m_MarkedNodes{};
+		std::vector<uint32_t> m_UpdatedNodes{};
+	};
+}
@@ -0,0 +1,200 @@
+#include "ThreadPool.h"
+
+//Standard includes
+#include <algorithm>
+
+//Platform includes
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	uint64_t PackRange(uint32_t begin, uint32_t end)
+	{
+		return static_cast<uint64_t>(begin) | static_cast<uint64_t>(end) << 32;
+	}
+
+	uint32_t RangeBegin(uint64_t packed) { return static_cast<uint32_t>(packed); }
+	uint32_t RangeEnd(uint64_t packed) { return static_cast<uint32_t>(packed >> 32); }
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount, bool pinThreads)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	m_ThreadCount = threadCount;
+	m_pRanges = std::make_unique<TaskRange[]>(threadCount);
+
+	// worker 0 is the thread calling ParallelFor, it is left unpinned
+	m_Workers.reserve(threadCount - 1);
+	for (uint32_t workerIndex{ 1 }; workerIndex < threadCount; ++workerIndex)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, workerIndex);
+
+		if (pinThreads)
+			PinThread(m_Workers.back(), workerIndex);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+	if (taskCount == 0)
+		return;
+
+	{
+		std::lock_guard lock{ m_Mutex };
+
+		for (uint32_t workerIndex{}; workerIndex < m_ThreadCount; ++workerIndex)
+		{
+			const uint32_t begin{ static_cast<uint32_t>(uint64_t{ taskCount } * workerIndex / m_ThreadCount) };
+			const uint32_t end{ static_cast<uint32_t>(uint64_t{ taskCount } * (workerIndex + 1) / m_ThreadCount) };
+			m_pRanges[workerIndex].packed.store(PackRange(begin, end), std::memory_order_relaxed);
+		}
+
+		m_pTask = &task;
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	RunTasks(0, task);
+
+	// every range is empty now, wait for the tasks other workers are still running
+	std::unique_lock lock{ m_Mutex };
+	m_DoneCondition.wait(lock, [this] { return m_BusyWorkers == 0; });
+	m_pTask = nullptr;
+}
+
+void ThreadPool::WorkerLoop(uint32_t workerIndex)
+{
+	uint64_t seenGeneration{};
+
+	while (true)
+	{
+		const std::function<void(uint32_t)>* pTask{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_WakeCondition.wait(lock, [&] { return m_IsStopping || m_Generation != seenGeneration; });
+
+			if (m_IsStopping)
+				return;
+
+			seenGeneration = m_Generation;
+
+			// woke up after that ParallelFor already returned
+			if (!m_pTask)
+				continue;
+
+			pTask = m_pTask;
+			++m_BusyWorkers;
+		}
+
+		RunTasks(workerIndex, *pTask);
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			--m_BusyWorkers;
+		}
+		m_DoneCondition.notify_one();
+	}
+}
+
+void ThreadPool::RunTasks(uint32_t workerIndex, const std::function<void(uint32_t)>& task)
+{
+	uint32_t taskIndex{};
+
+	while (PopTask(workerIndex, taskIndex) || StealTask(workerIndex, taskIndex))
+		task(taskIndex);
+}
+
+bool ThreadPool::PopTask(uint32_t workerIndex, uint32_t& taskIndex)
+{
+	// the owner takes from the front, in the order the tasks were handed out
+	std::atomic<uint64_t>& range{ m_pRanges[workerIndex].packed };
+	uint64_t packed{ range.load(std::memory_order_relaxed) };
+
+	while (RangeBegin(packed) < RangeEnd(packed))
+	{
+		if (range.compare_exchange_weak(packed, PackRange(RangeBegin(packed) + 1, RangeEnd(packed)), std::memory_order_acq_rel))
+		{
+			taskIndex = RangeBegin(packed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ThreadPool::StealTask(uint32_t workerIndex, uint32_t& taskIndex)
+{
+	// thieves take from the back, as far away from the owner as possible
+	for (uint32_t offset{ 1 }; offset < m_ThreadCount; ++offset)
+	{
+		std::atomic<uint64_t>& range{ m_pRanges[(workerIndex + offset) % m_ThreadCount].packed };
+		uint64_t packed{ range.load(std::memory_order_relaxed) };
+
+		while (RangeBegin(packed) < RangeEnd(packed))
+		{
+			if (range.compare_exchange_weak(packed, PackRange(RangeBegin(packed), RangeEnd(packed) - 1), std::memory_order_acq_rel))
+			{
+				taskIndex = RangeEnd(packed) - 1;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::PinThread(std::thread& thread, uint32_t coreIndex)
+{
+#ifdef _WIN32
+	// machines with more than 64 logical cores split them over processor groups
+	WORD group{};
+	const WORD groupCount{ GetActiveProcessorGroupCount() };
+	while (group < groupCount && coreIndex >= GetActiveProcessorCount(group))
+	{
+		coreIndex -= GetActiveProcessorCount(group);
+		++group;
+	}
+
+	if (group == groupCount)
+		return;
+
+	GROUP_AFFINITY affinity{};
+	affinity.Group = group;
+	affinity.Mask = KAFFINITY{ 1 } << coreIndex;
+	SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr);
+#elif defined(__linux__)
+	if (coreIndex >= CPU_SETSIZE)
+		return;
+
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(coreIndex, &cpuSet);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#else
+	(void)thread;
+	(void)coreIndex;
+#endif
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	/**
+	 * \brief Persistent worker threads that split every ParallelFor over per-thread task ranges.
+	 * Each worker starts on its own contiguous range and steals from the back of the others once it runs dry,
+	 * the calling thread joins in as worker 0
+	 */
+	class ThreadPool final
+	{
+	public:
+		// 0 uses every hardware thread, pinThreads locks worker i to logical core i
+		explicit ThreadPool(uint32_t threadCount = 0, bool pinThreads = false);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// Runs task(index) for every index in [0, taskCount) and returns once all of them are done
+		// Neighbouring indices start out on the same worker, so ordered tasks keep their locality
+		void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+		uint32_t GetThreadCount() const { return m_ThreadCount; }
+
+	private:
+		// [begin, end) packed as begin | end << 32 so owner and thieves can claim tasks with one CAS
+		struct alignas(64) TaskRange
+		{
+			std::atomic<uint64_t> packed{};
+		};
+
+		void WorkerLoop(uint32_t workerIndex);
+		void RunTasks(uint32_t workerIndex, const std::function<void(uint32_t)>& task);
+		bool PopTask(uint32_t workerIndex, uint32_t& taskIndex);
+		bool StealTask(uint32_t workerIndex, uint32_t& taskIndex);
+
+		static void PinThread(std::thread& thread, uint32_t coreIndex);
+
+		std::vector<std::thread> m_Workers{};
+		std::unique_ptr<TaskRange[]> m_pRanges{};
+		uint32_t m_ThreadCount{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		// Only set while a ParallelFor is running, guarded by m_Mutex
+		const std::function<void(uint32_t)>* m_pTask{};
+		uint64_t m_Generation{};
+		uint32_t m_BusyWorkers{};
+		bool m_IsStopping{ false };
+	};
+}
@@ -1,9 +1,11 @@
 #pragma once
 #include <array>
+#include <bit>
 #include <cassert>
-#include <fstream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "OBJLoader.h"
+#include "SIMD.h"
 
 namespace dae
 {
@@ -55,6 +57,74 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_Sphere(sphere, ray, temp, true);
 		}
+
+		/**
+		 * \brief Same test as HitTest_Sphere for the active lanes of a packet, four rays at a time.
+		 * Lanes that hit get their max shrunk to the hit distance
+		 * \return a bit per lane that hit
+		 */
+		inline uint32_t HitTest_SpherePacket(const Sphere& sphere, RayPacket& packet, uint32_t activeMask)
+		{
+			uint32_t hitMask{};
+
+#ifdef SIMD_SSE
+			// the rays share their origin, everything that only depends on it is done once
+			const Vector3 cameraToSphere{ packet.origin - sphere.origin };
+			const float c{ Vector3::Dot(cameraToSphere, cameraToSphere) - Square(sphere.radius) };
+
+			const __m128 offsetX{ _mm_set1_ps(cameraToSphere.x) };
+			const __m128 offsetY{ _mm_set1_ps(cameraToSphere.y) };
+			const __m128 offsetZ{ _mm_set1_ps(cameraToSphere.z) };
+			const __m128 two{ _mm_set1_ps(2.f) };
+
+			for (uint32_t first{}; first < RayPacket::Size; first += 4)
+			{
+				const uint32_t laneMask{ (activeMask >> first) & 0xF };
+				if (laneMask == 0)
+					continue;
+
+				const __m128 b{ _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_mul_ps(two, _mm_load_ps(packet.directionX + first)), offsetX),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_load_ps(packet.directionY + first)), offsetY)),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_load_ps(packet.directionZ + first)), offsetZ)) };
+
+				const __m128 discriminant{ _mm_sub_ps(_mm_mul_ps(b, b), _mm_set1_ps(4 * c)) };
+				const __m128 t{ _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(b, _mm_set1_ps(-0.f)), _mm_sqrt_ps(discriminant)), _mm_set1_ps(0.5f)) };
+
+				const __m128 valid{ _mm_and_ps(_mm_cmpgt_ps(discriminant, _mm_setzero_ps()),
+					_mm_and_ps(_mm_cmpgt_ps(t, _mm_set1_ps(packet.min)), _mm_cmplt_ps(t, _mm_load_ps(packet.max + first)))) };
+
+				uint32_t laneHits{ static_cast<uint32_t>(_mm_movemask_ps(valid)) & laneMask };
+				if (laneHits == 0)
+					continue;
+
+				alignas(16) float tValues[4];
+				_mm_store_ps(tValues, t);
+
+				hitMask |= laneHits << first;
+				while (laneHits)
+				{
+					const int lane{ std::countr_zero(laneHits) };
+					laneHits &= laneHits - 1;
+					packet.max[first + lane] = tValues[lane];
+				}
+			}
+#else
+			for (uint32_t lanes{ activeMask }; lanes; lanes &= lanes - 1)
+			{
+				const int lane{ std::countr_zero(lanes) };
+
+				HitRecord temp{};
+				if (!HitTest_Sphere(sphere, packet.GetRay(lane), temp))
+					continue;
+
+				packet.max[lane] = temp.t;
+				hitMask |= 1u << lane;
+			}
+#endif
+
+			return hitMask;
+		}
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS
@@ -299,6 +369,742 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_Triangle_Moller(triangle, ray, temp, true);
 		}
+
+		//Folds the cull mode into the sign the facing ratio has to have, +1 culls front faces, -1 back faces, 0 nothing
+		//Shadow rays (ignoreHitRecord) look from the other side, so their sign is flipped
+		inline float GetCullSign(TriangleCullMode cullMode, bool ignoreHitRecord = false)
+		{
+			float cullSign{};
+			switch (cullMode)
+			{
+			case TriangleCullMode::FrontFaceCulling:
+				cullSign = 1.f;
+				break;
+			case TriangleCullMode::BackFaceCulling:
+				cullSign = -1.f;
+				break;
+			case TriangleCullMode::NoCulling:
+				break;
+			}
+
+			return ignoreHitRecord ? -cullSign : cullSign;
+		}
+
+		//Moller-Trumbore on precomputed edges, cullSign comes from GetCullSign so the cull mode is only resolved once per ray
+		inline bool HitTest_TriangleRecord(const TriangleRecord& triangle, float cullSign, const Ray& ray, float& t, float& u, float& v)
+		{
+			const float normalViewDot{ Vector3::Dot(triangle.normal, ray.direction) };
+
+			if (cullSign != 0.f ? normalViewDot * cullSign <= 0 : abs(normalViewDot) < FLT_EPSILON)
+				return false;
+
+			const Vector3 pVec{ Vector3::Cross(ray.direction, triangle.edge2) };
+			const float det{ Vector3::Dot(triangle.edge1, pVec) };
+			if (abs(det) < FLT_EPSILON)
+				return false;
+
+			const float invDet{ 1.f / det };
+			const Vector3 tVec{ ray.origin - triangle.v0 };
+
+			const float hitU{ Vector3::Dot(tVec, pVec) * invDet };
+			if (hitU < 0 || hitU > 1.f)
+				return false;
+
+			const Vector3 qVec{ Vector3::Cross(tVec, triangle.edge1) };
+			const float hitV{ Vector3::Dot(ray.direction, qVec) * invDet };
+			if (hitV < 0 || hitU + hitV > 1.f)
+				return false;
+
+			const float hitT{ Vector3::Dot(triangle.edge2, qVec) * invDet };
+			if (hitT < ray.min || hitT > ray.max)
+				return false;
+
+			t = hitT;
+			u = hitU;
+			v = hitV;
+			return true;
+		}
+
+		/**
+		 * \brief Same test as HitTest_TriangleRecord for the active lanes of a packet, four rays at a time.
+		 * Lanes that hit get their max shrunk to the hit distance and their barycentrics written to u and v
+		 * \return a bit per lane that hit
+		 */
+		inline uint32_t HitTest_TriangleRecordPacket(const TriangleRecord& triangle, float cullSign, RayPacket& packet, uint32_t activeMask,
+													float u[RayPacket::Size], float v[RayPacket::Size])
+		{
+			uint32_t hitMask{};
+
+#ifdef SIMD_SSE
+			// tVec and qVec only depend on the shared origin
+			const Vector3 tVec{ packet.origin - triangle.v0 };
+			const Vector3 qVec{ Vector3::Cross(tVec, triangle.edge1) };
+			const float edge2DotQ{ Vector3::Dot(triangle.edge2, qVec) };
+
+			const __m128 epsilon{ _mm_set1_ps(FLT_EPSILON) };
+			const __m128 absMask{ _mm_set1_ps(-0.f) };
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+
+			for (uint32_t first{}; first < RayPacket::Size; first += 4)
+			{
+				const uint32_t laneMask{ (activeMask >> first) & 0xF };
+				if (laneMask == 0)
+					continue;
+
+				const __m128 dirX{ _mm_load_ps(packet.directionX + first) };
+				const __m128 dirY{ _mm_load_ps(packet.directionY + first) };
+				const __m128 dirZ{ _mm_load_ps(packet.directionZ + first) };
+
+				const __m128 normalViewDot{ _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(triangle.normal.x), dirX),
+					_mm_mul_ps(_mm_set1_ps(triangle.normal.y), dirY)),
+					_mm_mul_ps(_mm_set1_ps(triangle.normal.z), dirZ)) };
+
+				__m128 valid{ cullSign != 0.f ?
+					_mm_cmpgt_ps(_mm_mul_ps(normalViewDot, _mm_set1_ps(cullSign)), zero) :
+					_mm_cmpge_ps(_mm_andnot_ps(absMask, normalViewDot), epsilon) };
+
+				if ((_mm_movemask_ps(valid) & laneMask) == 0)
+					continue;
+
+				const __m128 edge2X{ _mm_set1_ps(triangle.edge2.x) };
+				const __m128 edge2Y{ _mm_set1_ps(triangle.edge2.y) };
+				const __m128 edge2Z{ _mm_set1_ps(triangle.edge2.z) };
+
+				// pVec = direction x edge2
+				const __m128 pVecX{ _mm_sub_ps(_mm_mul_ps(dirY, edge2Z), _mm_mul_ps(dirZ, edge2Y)) };
+				const __m128 pVecY{ _mm_sub_ps(_mm_mul_ps(dirZ, edge2X), _mm_mul_ps(dirX, edge2Z)) };
+				const __m128 pVecZ{ _mm_sub_ps(_mm_mul_ps(dirX, edge2Y), _mm_mul_ps(dirY, edge2X)) };
+
+				const __m128 det{ _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(triangle.edge1.x), pVecX),
+					_mm_mul_ps(_mm_set1_ps(triangle.edge1.y), pVecY)),
+					_mm_mul_ps(_mm_set1_ps(triangle.edge1.z), pVecZ)) };
+				valid = _mm_and_ps(valid, _mm_cmpge_ps(_mm_andnot_ps(absMask, det), epsilon));
+
+				const __m128 invDet{ _mm_div_ps(one, det) };
+
+				const __m128 uLanes{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(tVec.x), pVecX),
+					_mm_mul_ps(_mm_set1_ps(tVec.y), pVecY)),
+					_mm_mul_ps(_mm_set1_ps(tVec.z), pVecZ)), invDet) };
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(uLanes, zero), _mm_cmple_ps(uLanes, one)));
+
+				const __m128 vLanes{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(dirX, _mm_set1_ps(qVec.x)),
+					_mm_mul_ps(dirY, _mm_set1_ps(qVec.y))),
+					_mm_mul_ps(dirZ, _mm_set1_ps(qVec.z))), invDet) };
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(vLanes, zero), _mm_cmple_ps(_mm_add_ps(uLanes, vLanes), one)));
+
+				const __m128 tLanes{ _mm_mul_ps(_mm_set1_ps(edge2DotQ), invDet) };
+				valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(tLanes, _mm_set1_ps(packet.min)),
+					_mm_cmple_ps(tLanes, _mm_load_ps(packet.max + first))));
+
+				uint32_t laneHits{ static_cast<uint32_t>(_mm_movemask_ps(valid)) & laneMask };
+				if (laneHits == 0)
+					continue;
+
+				alignas(16) float tValues[4];
+				alignas(16) float uValues[4];
+				alignas(16) float vValues[4];
+				_mm_store_ps(tValues, tLanes);
+				_mm_store_ps(uValues, uLanes);
+				_mm_store_ps(vValues, vLanes);
+
+				hitMask |= laneHits << first;
+				while (laneHits)
+				{
+					const int lane{ std::countr_zero(laneHits) };
+					laneHits &= laneHits - 1;
+
+					packet.max[first + lane] = tValues[lane];
+					u[first + lane] = uValues[lane];
+					v[first + lane] = vValues[lane];
+				}
+			}
+#else
+			for (uint32_t lanes{ activeMask }; lanes; lanes &= lanes - 1)
+			{
+				const int lane{ std::countr_zero(lanes) };
+
+				float t{};
+				if (!HitTest_TriangleRecord(triangle, cullSign, packet.GetRay(lane), t, u[lane], v[lane]))
+					continue;
+
+				packet.max[lane] = t;
+				hitMask |= 1u << lane;
+			}
+#endif
+
+			return hitMask;
+		}
+
+		/**
+		 * \brief Moller-Trumbore against the four triangles of a block at once, culling works like HitTest_TriangleRecord.
+		 * \return the lane of the closest triangle within [ray.min, ray.max], -1 when none of them was hit
+		 */
+		inline int HitTest_TriangleBlock(const TriangleBlock& block, float cullSign, const Ray& ray, float& t, float& u, float& v)
+		{
+#ifdef SIMD_SSE
+			const __m128 dirX{ _mm_set1_ps(ray.direction.x) };
+			const __m128 dirY{ _mm_set1_ps(ray.direction.y) };
+			const __m128 dirZ{ _mm_set1_ps(ray.direction.z) };
+			const __m128 epsilon{ _mm_set1_ps(FLT_EPSILON) };
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
+
+			const __m128 normalViewDot{ _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_load_ps(block.normalX), dirX),
+				_mm_mul_ps(_mm_load_ps(block.normalY), dirY)),
+				_mm_mul_ps(_mm_load_ps(block.normalZ), dirZ)) };
+
+			__m128 valid{ cullSign != 0.f ?
+				_mm_cmpgt_ps(_mm_mul_ps(normalViewDot, _mm_set1_ps(cullSign)), zero) :
+				_mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), normalViewDot), epsilon) };
+
+			if (_mm_movemask_ps(valid) == 0)
+				return -1;
+
+			const __m128 edge1X{ _mm_load_ps(block.edge1X) };
+			const __m128 edge1Y{ _mm_load_ps(block.edge1Y) };
+			const __m128 edge1Z{ _mm_load_ps(block.edge1Z) };
+			const __m128 edge2X{ _mm_load_ps(block.edge2X) };
+			const __m128 edge2Y{ _mm_load_ps(block.edge2Y) };
+			const __m128 edge2Z{ _mm_load_ps(block.edge2Z) };
+
+			// pVec = direction x edge2
+			const __m128 pVecX{ _mm_sub_ps(_mm_mul_ps(dirY, edge2Z), _mm_mul_ps(dirZ, edge2Y)) };
+			const __m128 pVecY{ _mm_sub_ps(_mm_mul_ps(dirZ, edge2X), _mm_mul_ps(dirX, edge2Z)) };
+			const __m128 pVecZ{ _mm_sub_ps(_mm_mul_ps(dirX, edge2Y), _mm_mul_ps(dirY, edge2X)) };
+
+			const __m128 det{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pVecX), _mm_mul_ps(edge1Y, pVecY)), _mm_mul_ps(edge1Z, pVecZ)) };
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), det), epsilon));
+
+			const __m128 invDet{ _mm_div_ps(one, det) };
+
+			const __m128 tVecX{ _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(block.v0X)) };
+			const __m128 tVecY{ _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(block.v0Y)) };
+			const __m128 tVecZ{ _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(block.v0Z)) };
+
+			const __m128 uLanes{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tVecX, pVecX), _mm_mul_ps(tVecY, pVecY)), _mm_mul_ps(tVecZ, pVecZ)), invDet) };
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(uLanes, zero), _mm_cmple_ps(uLanes, one)));
+
+			// qVec = tVec x edge1
+			const __m128 qVecX{ _mm_sub_ps(_mm_mul_ps(tVecY, edge1Z), _mm_mul_ps(tVecZ, edge1Y)) };
+			const __m128 qVecY{ _mm_sub_ps(_mm_mul_ps(tVecZ, edge1X), _mm_mul_ps(tVecX, edge1Z)) };
+			const __m128 qVecZ{ _mm_sub_ps(_mm_mul_ps(tVecX, edge1Y), _mm_mul_ps(tVecY, edge1X)) };
+
+			const __m128 vLanes{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, qVecX), _mm_mul_ps(dirY, qVecY)), _mm_mul_ps(dirZ, qVecZ)), invDet) };
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(vLanes, zero), _mm_cmple_ps(_mm_add_ps(uLanes, vLanes), one)));
+
+			const __m128 tLanes{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qVecX), _mm_mul_ps(edge2Y, qVecY)), _mm_mul_ps(edge2Z, qVecZ)), invDet) };
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(tLanes, _mm_set1_ps(ray.min)), _mm_cmple_ps(tLanes, _mm_set1_ps(ray.max))));
+
+			int mask{ _mm_movemask_ps(valid) };
+			if (mask == 0)
+				return -1;
+
+			alignas(16) float tValues[TriangleBlock::Width];
+			alignas(16) float uValues[TriangleBlock::Width];
+			alignas(16) float vValues[TriangleBlock::Width];
+			_mm_store_ps(tValues, tLanes);
+			_mm_store_ps(uValues, uLanes);
+			_mm_store_ps(vValues, vLanes);
+
+			int closestLane{ -1 };
+			while (mask)
+			{
+				const int lane{ std::countr_zero(static_cast<unsigned int>(mask)) };
+				mask &= mask - 1;
+
+				if (closestLane < 0 || tValues[lane] <= tValues[closestLane])
+					closestLane = lane;
+			}
+
+			t = tValues[closestLane];
+			u = uValues[closestLane];
+			v = vValues[closestLane];
+			return closestLane;
+#else
+			int closestLane{ -1 };
+			float closestT{ ray.max };
+
+			for (uint32_t lane{}; lane < TriangleBlock::Width; ++lane)
+			{
+				if (block.triangleIndex[lane] == TriangleBlock::InvalidTriangle)
+					continue;
+
+				const TriangleRecord triangle{
+					{ block.v0X[lane], block.v0Y[lane], block.v0Z[lane] },
+					{ block.edge1X[lane], block.edge1Y[lane], block.edge1Z[lane] },
+					{ block.edge2X[lane], block.edge2Y[lane], block.edge2Z[lane] },
+					{ block.normalX[lane], block.normalY[lane], block.normalZ[lane] } };
+
+				Ray laneRay{ ray };
+				laneRay.max = closestT;
+
+				if (!HitTest_TriangleRecord(triangle, cullSign, laneRay, t, u, v))
+					continue;
+
+				closestLane = static_cast<int>(lane);
+				closestT = t;
+			}
+
+			return closestLane;
+#endif
+		}
+#pragma endregion
+#pragma region BVH Traversal
+		inline Vector3 InverseDirection(const Ray& ray)
+		{
+			return { 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+		}
+
+		//Returns the entry distance of the ray into the box, FLT_MAX when it misses
+		inline float SlabTest_AABB(const AABB& bounds, const Ray& ray, const Vector3& invDirection)
+		{
+			const float tx1{ (bounds.minAABB.x - ray.origin.x) * invDirection.x };
+			const float tx2{ (bounds.maxAABB.x - ray.origin.x) * invDirection.x };
+
+			float tmin{ std::min(tx1, tx2) };
+			float tmax{ std::max(tx1, tx2) };
+
+			const float ty1{ (bounds.minAABB.y - ray.origin.y) * invDirection.y };
+			const float ty2{ (bounds.maxAABB.y - ray.origin.y) * invDirection.y };
+
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1{ (bounds.minAABB.z - ray.origin.z) * invDirection.z };
+			const float tz2{ (bounds.maxAABB.z - ray.origin.z) * invDirection.z };
+
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			if (tmax >= tmin && tmax > 0 && tmin < ray.max)
+				return tmin;
+
+			return FLT_MAX;
+		}
+
+		/**
+		 * \brief Walks the hierarchy front to back, calling intersectPrimitive(primitiveIndex, ray) for every primitive in a visited leaf.
+		 * The callback shrinks ray.max when it reports a hit, which culls everything behind it
+		 * \param anyHit stop at the first reported hit (shadow rays)
+		 * \return true if any primitive reported a hit
+		 */
+		template<typename IntersectPrimitive>
+		bool TraverseBVH(const BVH& bvh, Ray& ray, bool anyHit, IntersectPrimitive&& intersectPrimitive)
+		{
+			if (bvh.IsEmpty())
+				return false;
+
+			const Vector3 invDirection{ InverseDirection(ray) };
+			const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+			const std::vector<uint32_t>& primitiveIndices{ bvh.GetPrimitiveIndices() };
+
+			if (SlabTest_AABB(nodes[0].bounds, ray, invDirection) == FLT_MAX)
+				return false;
+
+			struct StackEntry
+			{
+				uint32_t nodeIndex;
+				float distance;
+			};
+
+			StackEntry stack[BVH::MaxDepth + 1];
+			uint32_t stackSize{};
+			uint32_t nodeIndex{};
+			bool didHit{ false };
+
+			while (true)
+			{
+				const BVHNode& node{ nodes[nodeIndex] };
+
+				if (node.IsLeaf())
+				{
+					for (uint32_t index{}; index < node.primitiveCount; ++index)
+					{
+						if (intersectPrimitive(primitiveIndices[node.leftFirst + index], ray))
+						{
+							if (anyHit)
+								return true;
+
+							didHit = true;
+						}
+					}
+
+					// pop until a node is found that is still in front of the closest hit
+					while (stackSize > 0 && stack[stackSize - 1].distance >= ray.max)
+						--stackSize;
+
+					if (stackSize == 0)
+						break;
+
+					nodeIndex = stack[--stackSize].nodeIndex;
+					continue;
+				}
+
+				// visit the nearest child first, push the other one if it is still in range
+				uint32_t nearIndex{ node.leftFirst };
+				uint32_t farIndex{ node.leftFirst + 1 };
+				float nearDistance{ SlabTest_AABB(nodes[nearIndex].bounds, ray, invDirection) };
+				float farDistance{ SlabTest_AABB(nodes[farIndex].bounds, ray, invDirection) };
+
+				if (nearDistance > farDistance)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(nearDistance, farDistance);
+				}
+
+				if (nearDistance == FLT_MAX)
+				{
+					// pop until a node is found that is still in front of the closest hit
+					while (stackSize > 0 && stack[stackSize - 1].distance >= ray.max)
+						--stackSize;
+
+					if (stackSize == 0)
+						break;
+
+					nodeIndex = stack[--stackSize].nodeIndex;
+					continue;
+				}
+
+				nodeIndex = nearIndex;
+				if (farDistance != FLT_MAX)
+					stack[stackSize++] = { farIndex, farDistance };
+			}
+
+			return didHit;
+		}
+
+		//Slab test of the four children of a wide node at once, returns a bit per child that was hit
+		inline int SlabTest_WideNode(const WideBVHNode& node, const Ray& ray, const Vector3& invDirection, float distances[WideBVH::Width])
+		{
+#ifdef SIMD_SSE
+			const __m128 originX{ _mm_set1_ps(ray.origin.x) };
+			const __m128 originY{ _mm_set1_ps(ray.origin.y) };
+			const __m128 originZ{ _mm_set1_ps(ray.origin.z) };
+			const __m128 invX{ _mm_set1_ps(invDirection.x) };
+			const __m128 invY{ _mm_set1_ps(invDirection.y) };
+			const __m128 invZ{ _mm_set1_ps(invDirection.z) };
+
+			const __m128 tx1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), originX), invX) };
+			const __m128 tx2{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), originX), invX) };
+			const __m128 ty1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), originY), invY) };
+			const __m128 ty2{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), originY), invY) };
+			const __m128 tz1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), originZ), invZ) };
+			const __m128 tz2{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), originZ), invZ) };
+
+			const __m128 tmin{ _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2)) };
+			const __m128 tmax{ _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2)) };
+
+			const __m128 hit{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(tmax, tmin), _mm_cmpgt_ps(tmax, _mm_setzero_ps())),
+				_mm_cmplt_ps(tmin, _mm_set1_ps(ray.max))) };
+
+			_mm_storeu_ps(distances, tmin);
+			return _mm_movemask_ps(hit) & ((1 << node.childCount) - 1);
+#else
+			int mask{};
+			for (uint32_t slot{}; slot < node.childCount; ++slot)
+			{
+				const AABB bounds{ { node.minX[slot], node.minY[slot], node.minZ[slot] }, { node.maxX[slot], node.maxY[slot], node.maxZ[slot] } };
+				distances[slot] = SlabTest_AABB(bounds, ray, invDirection);
+				if (distances[slot] != FLT_MAX)
+					mask |= 1 << slot;
+			}
+			return mask;
+#endif
+		}
+
+		/**
+		 * \brief Same contract as TraverseBVH, but walks the 4-wide version of the hierarchy.
+		 * Children that were hit get visited nearest first. Leaves are handed over whole as intersectLeaf(first, count, ray),
+		 * the owner decides what the range points at (see WideBVH::RemapLeaves)
+		 */
+		template<typename IntersectLeaf>
+		bool TraverseWideBVH(const WideBVH& wideBVH, Ray& ray, bool anyHit, IntersectLeaf&& intersectLeaf)
+		{
+			if (wideBVH.IsEmpty())
+				return false;
+
+			const Vector3 invDirection{ InverseDirection(ray) };
+			const std::vector<WideBVHNode>& nodes{ wideBVH.GetNodes() };
+
+			struct StackEntry
+			{
+				uint32_t index;
+				uint32_t primitiveCount;
+				float distance;
+			};
+
+			// every visited node replaces itself with at most four children
+			StackEntry stack[(WideBVH::Width - 1) * BVH::MaxDepth + WideBVH::Width];
+			uint32_t stackSize{};
+			bool didHit{ false };
+
+			stack[stackSize++] = { 0, 0, 0.f };
+
+			while (stackSize > 0)
+			{
+				const StackEntry entry{ stack[--stackSize] };
+				if (entry.distance >= ray.max)
+					continue;
+
+				if (entry.primitiveCount > 0)
+				{
+					if (intersectLeaf(entry.index, entry.primitiveCount, ray))
+					{
+						if (anyHit)
+							return true;
+
+						didHit = true;
+					}
+					continue;
+				}
+
+				const WideBVHNode& node{ nodes[entry.index] };
+				float distances[WideBVH::Width];
+				int hitMask{ SlabTest_WideNode(node, ray, invDirection, distances) };
+
+				// sort the hit children far to near so the nearest ends up on top of the stack
+				StackEntry children[WideBVH::Width];
+				uint32_t childCount{};
+
+				while (hitMask)
+				{
+					const uint32_t slot{ static_cast<uint32_t>(std::countr_zero(static_cast<unsigned int>(hitMask))) };
+					hitMask &= hitMask - 1;
+
+					StackEntry child{ node.child[slot], node.primitiveCount[slot], distances[slot] };
+
+					uint32_t insertIndex{ childCount++ };
+					while (insertIndex > 0 && children[insertIndex - 1].distance < child.distance)
+					{
+						children[insertIndex] = children[insertIndex - 1];
+						--insertIndex;
+					}
+					children[insertIndex] = child;
+				}
+
+				for (uint32_t index{}; index < childCount; ++index)
+					stack[stackSize++] = children[index];
+			}
+
+			return didHit;
+		}
+#pragma endregion
+#pragma region Packet Traversal
+		//Planes through the packet origin and its corner directions, normals point inwards
+		struct PacketFrustum
+		{
+			Vector3 origin{};
+			Vector3 normals[4]{};
+		};
+
+		inline PacketFrustum GetPacketFrustum(const RayPacket& packet)
+		{
+			PacketFrustum frustum{ packet.origin };
+
+			const Vector3 center{ packet.cornerDirections[0] + packet.cornerDirections[1] + packet.cornerDirections[2] + packet.cornerDirections[3] };
+
+			for (int index{}; index < 4; ++index)
+			{
+				Vector3 normal{ Vector3::Cross(packet.cornerDirections[index], packet.cornerDirections[(index + 1) % 4]) };
+				if (Vector3::Dot(normal, center) < 0)
+					normal = -normal;
+
+				frustum.normals[index] = normal;
+			}
+
+			return frustum;
+		}
+
+		//True when the box lies completely outside one of the frustum planes, no ray of the packet can hit it
+		inline bool IsOutsideFrustum(const PacketFrustum& frustum, const AABB& bounds)
+		{
+			for (const Vector3& normal : frustum.normals)
+			{
+				const Vector3 farthestCorner{
+					normal.x >= 0 ? bounds.maxAABB.x : bounds.minAABB.x,
+					normal.y >= 0 ? bounds.maxAABB.y : bounds.minAABB.y,
+					normal.z >= 0 ? bounds.maxAABB.z : bounds.minAABB.z };
+
+				if (Vector3::Dot(normal, farthestCorner - frustum.origin) < 0)
+					return true;
+			}
+
+			return false;
+		}
+
+		//SlabTest_AABB for the active lanes of a packet, returns a bit per lane that hit and the nearest entry distance
+		inline uint32_t SlabTest_Packet(const AABB& bounds, const RayPacket& packet, uint32_t activeMask, float& nearestDistance)
+		{
+			uint32_t hitMask{};
+			nearestDistance = FLT_MAX;
+
+#ifdef SIMD_SSE
+			const __m128 minX{ _mm_set1_ps(bounds.minAABB.x - packet.origin.x) };
+			const __m128 minY{ _mm_set1_ps(bounds.minAABB.y - packet.origin.y) };
+			const __m128 minZ{ _mm_set1_ps(bounds.minAABB.z - packet.origin.z) };
+			const __m128 maxX{ _mm_set1_ps(bounds.maxAABB.x - packet.origin.x) };
+			const __m128 maxY{ _mm_set1_ps(bounds.maxAABB.y - packet.origin.y) };
+			const __m128 maxZ{ _mm_set1_ps(bounds.maxAABB.z - packet.origin.z) };
+
+			for (uint32_t first{}; first < RayPacket::Size; first += 4)
+			{
+				const uint32_t laneMask{ (activeMask >> first) & 0xF };
+				if (laneMask == 0)
+					continue;
+
+				const __m128 invX{ _mm_load_ps(packet.inverseDirectionX + first) };
+				const __m128 invY{ _mm_load_ps(packet.inverseDirectionY + first) };
+				const __m128 invZ{ _mm_load_ps(packet.inverseDirectionZ + first) };
+
+				const __m128 tx1{ _mm_mul_ps(minX, invX) };
+				const __m128 tx2{ _mm_mul_ps(maxX, invX) };
+				const __m128 ty1{ _mm_mul_ps(minY, invY) };
+				const __m128 ty2{ _mm_mul_ps(maxY, invY) };
+				const __m128 tz1{ _mm_mul_ps(minZ, invZ) };
+				const __m128 tz2{ _mm_mul_ps(maxZ, invZ) };
+
+				const __m128 tmin{ _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2)) };
+				const __m128 tmax{ _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2)) };
+
+				const __m128 hit{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(tmax, tmin), _mm_cmpgt_ps(tmax, _mm_setzero_ps())),
+					_mm_cmplt_ps(tmin, _mm_load_ps(packet.max + first))) };
+
+				uint32_t laneHits{ static_cast<uint32_t>(_mm_movemask_ps(hit)) & laneMask };
+				if (laneHits == 0)
+					continue;
+
+				alignas(16) float distances[4];
+				_mm_store_ps(distances, tmin);
+
+				hitMask |= laneHits << first;
+				while (laneHits)
+				{
+					const int lane{ std::countr_zero(laneHits) };
+					laneHits &= laneHits - 1;
+					nearestDistance = std::min(nearestDistance, distances[lane]);
+				}
+			}
+#else
+			for (uint32_t lanes{ activeMask }; lanes; lanes &= lanes - 1)
+			{
+				const int lane{ std::countr_zero(lanes) };
+				const Vector3 invDirection{ packet.inverseDirectionX[lane], packet.inverseDirectionY[lane], packet.inverseDirectionZ[lane] };
+
+				const float distance{ SlabTest_AABB(bounds, packet.GetRay(lane), invDirection) };
+				if (distance == FLT_MAX)
+					continue;
+
+				hitMask |= 1u << lane;
+				nearestDistance = std::min(nearestDistance, distance);
+			}
+#endif
+
+			return hitMask;
+		}
+
+		/**
+		 * \brief Walks the hierarchy with a whole packet, calling intersectPrimitive(primitiveIndex, packet, laneMask) for every primitive in a visited leaf.
+		 * Nodes outside the packet frustum are skipped without looking at the individual rays, laneMask holds the rays that reached the leaf.
+		 * Packets without a frustum skip straight to the per ray test.
+		 * The callback shrinks packet.max for the lanes it hit, any hit queries clear finished lanes from packet.activeMask instead
+		 * \return true if any primitive reported a hit
+		 */
+		template<typename IntersectPrimitive>
+		bool TraversePacketBVH(const BVH& bvh, RayPacket& packet, IntersectPrimitive&& intersectPrimitive)
+		{
+			if (bvh.IsEmpty() || packet.activeMask == 0)
+				return false;
+
+			const PacketFrustum frustum{ packet.hasFrustum ? GetPacketFrustum(packet) : PacketFrustum{} };
+			const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+			const std::vector<uint32_t>& primitiveIndices{ bvh.GetPrimitiveIndices() };
+
+			const auto testNode{
+				[&](uint32_t nodeIndex, uint32_t laneMask, float& distance) -> uint32_t
+				{
+					if (packet.hasFrustum && IsOutsideFrustum(frustum, nodes[nodeIndex].bounds))
+						return 0;
+
+					return SlabTest_Packet(nodes[nodeIndex].bounds, packet, laneMask, distance);
+				} };
+
+			struct StackEntry
+			{
+				uint32_t nodeIndex;
+				uint32_t laneMask;
+			};
+
+			StackEntry stack[BVH::MaxDepth + 1];
+			uint32_t stackSize{};
+			uint32_t nodeIndex{};
+			float rootDistance{};
+			uint32_t laneMask{ testNode(0, packet.activeMask, rootDistance) };
+			bool didHit{ false };
+
+			if (laneMask == 0)
+				return false;
+
+			while (true)
+			{
+				const BVHNode& node{ nodes[nodeIndex] };
+				laneMask &= packet.activeMask;
+
+				if (laneMask == 0)
+				{
+					// every ray that reached this node is already done
+				}
+				else if (!node.IsLeaf())
+				{
+					// visit the child the nearest ray enters first, push the other one if any ray hit it
+					uint32_t nearIndex{ node.leftFirst };
+					uint32_t farIndex{ node.leftFirst + 1 };
+					float nearDistance{}, farDistance{};
+					uint32_t nearMask{ testNode(nearIndex, laneMask, nearDistance) };
+					uint32_t farMask{ testNode(farIndex, laneMask, farDistance) };
+
+					if (nearMask == 0 || (farMask != 0 && farDistance < nearDistance))
+					{
+						std::swap(nearIndex, farIndex);
+						std::swap(nearMask, farMask);
+					}
+
+					if (nearMask != 0)
+					{
+						if (farMask != 0)
+							stack[stackSize++] = { farIndex, farMask };
+
+						nodeIndex = nearIndex;
+						laneMask = nearMask;
+						continue;
+					}
+				}
+				else
+				{
+					for (uint32_t index{}; index < node.primitiveCount && laneMask != 0; ++index)
+					{
+						if (intersectPrimitive(primitiveIndices[node.leftFirst + index], packet, laneMask))
+							didHit = true;
+
+						laneMask &= packet.activeMask;
+					}
+				}
+
+				if (stackSize == 0)
+					break;
+
+				--stackSize;
+				nodeIndex = stack[stackSize].nodeIndex;
+				laneMask = stack[stackSize].laneMask;
+			}
+
+			return didHit;
+		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
 
@@ -325,55 +1131,270 @@ namespace dae
 			return tmax > 0 && tmax >= tmin;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//Fills in the world space hit record of a triangle the ray hit at distance t with barycentrics u and v
+		inline void GetTriangleMeshHit(const TriangleMesh& mesh, uint32_t triangleIndex, float u, float v, float t, HitRecord& hitRecord)
+		{
+			const MeshGeometry& geometry{ mesh.GetTracedGeometry() };
+
+			// the hit point is only interpolated for the closest triangle
+			const int triangle{ static_cast<int>(triangleIndex) };
+			const Vector3 origin{ (1 - u - v) * geometry.GetVertex(triangle, 0)
+				+ u * geometry.GetVertex(triangle, 1)
+				+ v * geometry.GetVertex(triangle, 2) };
+
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = mesh.materialIndex;
+			hitRecord.t = t;
+
+			if (mesh.isRigid)
+			{
+				// barycentric point on the triangle, keeps shadow rays from starting below the surface
+				hitRecord.origin = mesh.worldTransform.TransformPoint(origin);
+				hitRecord.normal = mesh.normalTransform.TransformVector(geometry.GetNormal(triangle));
+			}
+			else
+			{
+				hitRecord.origin = origin;
+				hitRecord.normal = geometry.GetNormal(triangle);
+			}
+		}
+
+		//pHitTriangle receives the index of the triangle that was hit, also for shadow rays
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false,
+										BVHTraversalMode traversalMode = BVHTraversalMode::Binary, uint32_t* pHitTriangle = nullptr)
 		{
 			//todo W5
 			// slabtest
 			if (!SlabTest_TriangleMesh(mesh, ray))
 				return false;
 
-			//Triangle triangle{};
-			//triangle.cullMode = mesh.cullMode;
-			//triangle.materialIndex = mesh.materialIndex;
+			// only accept triangles closer than what has been hit so far
+			Ray meshRay{ ray };
+			meshRay.max = std::min(ray.max, hitRecord.t);
 
-			HitRecord temp{};
-			bool didHit{ false };
-
-			for (int index{}; index < static_cast<int>(mesh.normals.size()); ++index)
+			// rigid meshes: move the ray instead of the vertices
+			// the direction is left unnormalized so t means the same in both spaces
+			if (mesh.isRigid)
 			{
-				const int offset{ index * 3 };
+				meshRay.origin = mesh.inverseWorldTransform.TransformPoint(ray.origin);
+				meshRay.direction = mesh.inverseWorldTransform.TransformVector(ray.direction);
+			}
+
+			const MeshGeometry& geometry{ mesh.GetTracedGeometry() };
 
-				//triangle.v0 = mesh.transformedPositions[mesh.indices[offset]];
-				//triangle.v1 = mesh.transformedPositions[mesh.indices[offset + 1]];
-				//triangle.v2 = mesh.transformedPositions[mesh.indices[offset + 2]];
-				//triangle.normal = mesh.transformedNormals[index];
-				const Vector3& v0{ mesh.transformedPositions[mesh.indices[offset]] };
-				const Vector3& v1{ mesh.transformedPositions[mesh.indices[offset + 1]] };
-				const Vector3& v2{ mesh.transformedPositions[mesh.indices[offset + 2]] };
-				const Vector3& normal{ mesh.transformedNormals[index] };
+			const float cullSign{ GetCullSign(mesh.cullMode, ignoreHitRecord) };
 
-				if (HitTest_Triangle_Moller(v0, v1, v2, normal, mesh.cullMode, 
-											mesh.materialIndex, ray, temp, ignoreHitRecord))
-				//if (HitTest_Triangle_Moller(triangle, ray, temp, ignoreHitRecord))
+			uint32_t closestTriangle{};
+			float closestU{}, closestV{};
+
+			const auto intersectRecord{
+				[&](const TriangleRecord& triangle, uint32_t triangleIndex, Ray& traversalRay)
 				{
-					if (ignoreHitRecord)
-						return true;
+					float t{}, u{}, v{};
+					if (!HitTest_TriangleRecord(triangle, cullSign, traversalRay, t, u, v))
+						return false;
+
+					// shrink the ray so farther nodes and triangles get culled
+					traversalRay.max = t;
+					closestTriangle = triangleIndex;
+					closestU = u;
+					closestV = v;
+					return true;
+				} };
+
+			const auto intersectTriangle{
+				[&](uint32_t triangleIndex, Ray& traversalRay)
+				{
+					return intersectRecord(geometry.triangleRecords[triangleIndex], triangleIndex, traversalRay);
+				} };
+
+			// compact geometry has no records, they are decoded per visit
+			const auto intersectCompactTriangle{
+				[&](uint32_t triangleIndex, Ray& traversalRay)
+				{
+					return intersectRecord(geometry.compact.GetTriangleRecord(static_cast<int>(triangleIndex)), triangleIndex, traversalRay);
+				} };
+
+			const auto intersectBlock{
+				[&](const TriangleBlock& block, Ray& traversalRay)
+				{
+					float t{}, u{}, v{};
+					const int lane{ HitTest_TriangleBlock(block, cullSign, traversalRay, t, u, v) };
+					if (lane < 0)
+						return false;
+
+					traversalRay.max = t;
+					closestTriangle = block.triangleIndex[lane];
+					closestU = u;
+					closestV = v;
+					return true;
+				} };
+
+			// wide leaves point at blocks of four triangles that are tested together
+			const auto intersectBlocks{
+				[&](uint32_t firstBlock, uint32_t blockCount, Ray& traversalRay)
+				{
+					bool didHitBlock{ false };
 
-					if (temp.t < hitRecord.t)
+					for (uint32_t blockIndex{ firstBlock }; blockIndex < firstBlock + blockCount; ++blockIndex)
 					{
-						hitRecord = temp;
-						didHit = true;
+						if (!intersectBlock(geometry.triangleBlocks[blockIndex], traversalRay))
+							continue;
+
+						didHitBlock = true;
+						if (ignoreHitRecord)
+							break;
 					}
-				}
+
+					return didHitBlock;
+				} };
+
+			// compact leaves point at triangles instead, they are decoded into a block four at a time
+			const auto intersectCompactLeaf{
+				[&](uint32_t firstTriangle, uint32_t triangleCount, Ray& traversalRay)
+				{
+					const uint32_t* pTriangleIndices{ geometry.bvh.GetPrimitiveIndices().data() + firstTriangle };
+					bool didHitBlock{ false };
+					TriangleBlock block;
+
+					for (uint32_t blockStart{}; blockStart < triangleCount; blockStart += TriangleBlock::Width)
+					{
+						geometry.compact.GetTriangleBlock(pTriangleIndices + blockStart, std::min(triangleCount - blockStart, TriangleBlock::Width), block);
+						if (!intersectBlock(block, traversalRay))
+							continue;
+
+						didHitBlock = true;
+						if (ignoreHitRecord)
+							break;
+					}
+
+					return didHitBlock;
+				} };
+
+			// the layout is picked once per mesh, the leaf tests themselves don't branch on it
+			bool didHit{};
+			if (traversalMode == BVHTraversalMode::Wide)
+			{
+				didHit = geometry.isCompact ?
+					TraverseWideBVH(geometry.wideBVH, meshRay, ignoreHitRecord, intersectCompactLeaf) :
+					TraverseWideBVH(geometry.wideBVH, meshRay, ignoreHitRecord, intersectBlocks);
 			}
-			
-			return didHit;
+			else
+			{
+				didHit = geometry.isCompact ?
+					TraverseBVH(geometry.bvh, meshRay, ignoreHitRecord, intersectCompactTriangle) :
+					TraverseBVH(geometry.bvh, meshRay, ignoreHitRecord, intersectTriangle);
+			}
+
+			if (didHit && pHitTriangle)
+				*pHitTriangle = closestTriangle;
+
+			if (!didHit || ignoreHitRecord)
+				return didHit;
+
+			GetTriangleMeshHit(mesh, closestTriangle, closestU, closestV, meshRay.max, hitRecord);
+			return true;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, BVHTraversalMode traversalMode = BVHTraversalMode::Binary,
+										uint32_t* pHitTriangle = nullptr)
 		{
 			HitRecord temp{};
-			return HitTest_TriangleMesh(mesh, ray, temp, true);
+			return HitTest_TriangleMesh(mesh, ray, temp, true, traversalMode, pHitTriangle);
+		}
+
+		//Shadow test against a single triangle of the mesh, used to retry the triangle that blocked a previous shadow ray
+		inline bool HitTest_MeshTriangle(const TriangleMesh& mesh, uint32_t triangleIndex, const Ray& ray)
+		{
+			const MeshGeometry& geometry{ mesh.GetTracedGeometry() };
+			if (triangleIndex >= static_cast<uint32_t>(geometry.GetTriangleCount()))
+				return false;
+
+			Ray meshRay{ ray };
+			if (mesh.isRigid)
+			{
+				meshRay.origin = mesh.inverseWorldTransform.TransformPoint(ray.origin);
+				meshRay.direction = mesh.inverseWorldTransform.TransformVector(ray.direction);
+			}
+
+			float t{}, u{}, v{};
+			return HitTest_TriangleRecord(geometry.GetTriangleRecord(static_cast<int>(triangleIndex)), GetCullSign(mesh.cullMode, true), meshRay, t, u, v);
+		}
+
+		/**
+		 * \brief Closest hit of the active lanes of a packet against a mesh, lanes that hit get their max shrunk.
+		 * closestTriangle, u and v are written for the lanes that hit, GetTriangleMeshHit turns them into a hit record.
+		 * With ignoreHitRecord the lanes are shadow rays that stop at their first hit
+		 * \return a bit per lane that hit
+		 */
+		inline uint32_t HitTest_TriangleMeshPacket(const TriangleMesh& mesh, RayPacket& packet, uint32_t activeMask,
+													uint32_t closestTriangle[RayPacket::Size], float u[RayPacket::Size], float v[RayPacket::Size],
+													bool ignoreHitRecord = false)
+		{
+			RayPacket meshPacket{ packet };
+			meshPacket.activeMask = activeMask;
+
+			// rigid meshes: move the packet instead of the vertices, the same way HitTest_TriangleMesh moves a single ray
+			if (mesh.isRigid)
+			{
+				meshPacket.origin = mesh.inverseWorldTransform.TransformPoint(packet.origin);
+
+				for (uint32_t lanes{ activeMask }; lanes; lanes &= lanes - 1)
+				{
+					const int lane{ std::countr_zero(lanes) };
+					const Vector3 direction{ packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane] };
+					meshPacket.SetRay(lane, mesh.inverseWorldTransform.TransformVector(direction), packet.max[lane]);
+				}
+
+				for (Vector3& cornerDirection : meshPacket.cornerDirections)
+					cornerDirection = mesh.inverseWorldTransform.TransformVector(cornerDirection);
+			}
+
+			const MeshGeometry& geometry{ mesh.GetTracedGeometry() };
+			const float cullSign{ GetCullSign(mesh.cullMode, ignoreHitRecord) };
+			uint32_t hitMask{};
+
+			const auto intersectRecord{
+				[&](const TriangleRecord& triangle, uint32_t triangleIndex, RayPacket& traversalPacket, uint32_t laneMask)
+				{
+					const uint32_t triangleHits{ HitTest_TriangleRecordPacket(triangle, cullSign, traversalPacket, laneMask, u, v) };
+					hitMask |= triangleHits;
+
+					if (ignoreHitRecord)
+						traversalPacket.activeMask &= ~triangleHits;
+
+					for (uint32_t lanes{ triangleHits }; lanes; lanes &= lanes - 1)
+						closestTriangle[std::countr_zero(lanes)] = triangleIndex;
+
+					return triangleHits != 0;
+				} };
+
+			// compact geometry decodes every triangle once per packet that visits it
+			if (geometry.isCompact)
+			{
+				TraversePacketBVH(geometry.bvh, meshPacket,
+					[&](uint32_t triangleIndex, RayPacket& traversalPacket, uint32_t laneMask)
+					{
+						return intersectRecord(geometry.compact.GetTriangleRecord(static_cast<int>(triangleIndex)), triangleIndex, traversalPacket, laneMask);
+					});
+			}
+			else
+			{
+				TraversePacketBVH(geometry.bvh, meshPacket,
+					[&](uint32_t triangleIndex, RayPacket& traversalPacket, uint32_t laneMask)
+					{
+						return intersectRecord(geometry.triangleRecords[triangleIndex], triangleIndex, traversalPacket, laneMask);
+					});
+			}
+
+			// t means the same in both spaces
+			for (uint32_t lanes{ hitMask }; lanes; lanes &= lanes - 1)
+			{
+				const int lane{ std::countr_zero(lanes) };
+				packet.max[lane] = meshPacket.max[lane];
+			}
+
+			return hitMask;
 		}
 
 #pragma endregion
@@ -404,75 +1425,12 @@ namespace dae
 
 	namespace Utils
 	{
-		//Just parses vertices and indices
+		//Triangles of any OBJ file with a normal per triangle, texture coordinates, vertex normals and groups are dropped. See OBJLoader, loads after the first come from its cache
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
 		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
-
-			return true;
+			return OBJLoader::Load(filename, positions, normals, indices);
 		}
 #pragma warning(pop)
 	}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+
+#include "SIMD.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	/**
+	 * \brief Eight Vector3s stored a component per array, so SIMD::LaneCount of them fill one register per component.
+	 * Load and Store convert from and to the usual array of Vector3s
+	 */
+	struct Vector3x8
+	{
+		static constexpr uint32_t Size{ 8 };
+		static_assert(Size % SIMD::LaneCount == 0, "Has to split into whole registers");
+
+		alignas(32) float x[Size]{};
+		alignas(32) float y[Size]{};
+		alignas(32) float z[Size]{};
+
+		//Reads count vectors, the lanes after them keep their values
+		void Load(const Vector3* pVectors, uint32_t count = Size)
+		{
+#ifdef SIMD_SSE
+			if (count == Size)
+			{
+				for (uint32_t lane{}; lane < Size; lane += 4)
+					LoadFour(pVectors + lane, lane);
+				return;
+			}
+#endif
+			for (uint32_t lane{}; lane < count; ++lane)
+				Set(lane, pVectors[lane]);
+		}
+
+		void Store(Vector3* pVectors, uint32_t count = Size) const
+		{
+#ifdef SIMD_SSE
+			if (count == Size)
+			{
+				for (uint32_t lane{}; lane < Size; lane += 4)
+					StoreFour(pVectors + lane, lane);
+				return;
+			}
+#endif
+			for (uint32_t lane{}; lane < count; ++lane)
+				pVectors[lane] = Get(lane);
+		}
+
+		Vector3 Get(uint32_t lane) const { return { x[lane], y[lane], z[lane] }; }
+
+		void Set(uint32_t lane, const Vector3& v)
+		{
+			x[lane] = v.x;
+			y[lane] = v.y;
+			z[lane] = v.z;
+		}
+
+		//Lanes firstLane up to firstLane + the lane count of Lanes, firstLane has to be a multiple of that count
+		template<typename Lanes>
+		SIMD::Vector3Lanes<Lanes> GetLanes(uint32_t firstLane) const
+		{
+			return SIMD::Load3<Lanes>(x + firstLane, y + firstLane, z + firstLane);
+		}
+
+		template<typename Lanes>
+		void SetLanes(uint32_t firstLane, const SIMD::Vector3Lanes<Lanes>& v)
+		{
+			SIMD::Store(x + firstLane, v.x);
+			SIMD::Store(y + firstLane, v.y);
+			SIMD::Store(z + firstLane, v.z);
+		}
+
+	private:
+#ifdef SIMD_SSE
+		static_assert(sizeof(Vector3) == 3 * sizeof(float), "Four vectors have to fill exactly three registers");
+
+		// Four packed vectors are three registers: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		void LoadFour(const Vector3* pVectors, uint32_t firstLane)
+		{
+			const float* pFloats{ &pVectors->x };
+			const __m128 a{ _mm_loadu_ps(pFloats) };
+			const __m128 b{ _mm_loadu_ps(pFloats + 4) };
+			const __m128 c{ _mm_loadu_ps(pFloats + 8) };
+
+			const __m128 x2y2x3y3{ _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)) };
+			const __m128 y0z0y1z1{ _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)) };
+
+			_mm_store_ps(x + firstLane, _mm_shuffle_ps(a, x2y2x3y3, _MM_SHUFFLE(2, 0, 3, 0)));
+			_mm_store_ps(y + firstLane, _mm_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0)));
+			_mm_store_ps(z + firstLane, _mm_shuffle_ps(y0z0y1z1, c, _MM_SHUFFLE(3, 0, 3, 1)));
+		}
+
+		void StoreFour(Vector3* pVectors, uint32_t firstLane) const
+		{
+			const __m128 xs{ _mm_load_ps(x + firstLane) };
+			const __m128 ys{ _mm_load_ps(y + firstLane) };
+			const __m128 zs{ _mm_load_ps(z + firstLane) };
+
+			const __m128 x0y0x1y1{ _mm_unpacklo_ps(xs, ys) };
+			const __m128 x2y2x3y3{ _mm_unpackhi_ps(xs, ys) };
+			const __m128 z0z0x1x1{ _mm_shuffle_ps(zs, xs, _MM_SHUFFLE(1, 1, 0, 0)) };
+			const __m128 y1y2z1z2{ _mm_shuffle_ps(ys, zs, _MM_SHUFFLE(2, 1, 2, 1)) };
+			const __m128 z2z2x3x3{ _mm_shuffle_ps(zs, xs, _MM_SHUFFLE(3, 3, 2, 2)) };
+			const __m128 y3y3z3z3{ _mm_shuffle_ps(ys, zs, _MM_SHUFFLE(3, 3, 3, 3)) };
+
+			float* pFloats{ &pVectors->x };
+			_mm_storeu_ps(pFloats, _mm_shuffle_ps(x0y0x1y1, z0z0x1x1, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(pFloats + 4, _mm_shuffle_ps(y1y2z1z2, x2y2x3y3, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(pFloats + 8, _mm_shuffle_ps(z2z2x3x3, y3y3z3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+#endif
+	};
+}
@@ -6,6 +6,7 @@
 
 //Standard includes
 #include <iostream>
+#include <string_view>
 
 //Project includes
 #include "Timer.h"
@@ -22,10 +23,6 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
-
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -48,7 +45,13 @@ int main(int argc, char* args[])
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
 
-	const auto pScene = new Scene_W4_BunnyScene();
+	//--many-lights starts the many lights scene instead of the bunny
+	Scene* pScene{};
+	if (argc > 1 && std::string_view{ args[1] } == "--many-lights")
+		pScene = new Scene_W4_ManyLightsScene();
+	else
+		pScene = new Scene_W4_BunnyScene();
+
 	pScene->Initialize();
 
 	//Start loop
@@ -85,6 +88,18 @@ int main(int argc, char* args[])
 					case SDLK_F3:
 					pRenderer->CycleLightMode();
 						break;
+					case SDLK_F4:
+						pScene->CycleTraversalMode();
+						break;
+					case SDLK_F5:
+						pRenderer->TogglePackets();
+						break;
+					case SDLK_F6:
+						pRenderer->ToggleStochasticLights();
+						break;
+					case SDLK_F7:
+						pScene->CompactMeshes();
+						break;
 				}
 				break;
 			}